@@ -0,0 +1,74 @@
+/*
+ * border_cull_bench.cpp
+ *
+ * Triangles of a 9x9 grid of solid chunks meshed without and with the
+ * neighbours' border layers, and the cost of copying the borders.
+ *
+ *   make -C bench && bench/build/border_cull_bench
+ */
+
+#include "mesher.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr int grid = 9;
+
+std::shared_ptr<Chunk> solid_chunk()
+{
+	Chunk::ChunkData blocks;
+	blocks.fill(Block(1));
+	return std::make_shared<Chunk>(blocks);
+}
+
+size_t grid_triangles(const World &world, const BlockRegistry &registry,
+		MeshingMode mode, bool use_borders)
+{
+	std::vector<MeshVertex> vertices(max_chunk_vertices);
+	size_t total = 0;
+	for (int x = 0; x < grid; x++)
+		for (int y = 0; y < grid; y++)
+		{
+			const ChunkCoord coord(x, y, 0);
+			const ChunkBorders borders = chunk_borders(world, coord);
+			total += mesh_chunk(*world.find_chunk(coord), registry, mode,
+					vertices.data(), use_borders ? &borders : nullptr);
+		}
+	return total / quad_vertices * 2;
+}
+
+}
+
+int main()
+{
+	const BlockRegistry registry(standard_texture_storage());
+	World world;
+	for (int x = 0; x < grid; x++)
+		for (int y = 0; y < grid; y++)
+			world.set_chunk(ChunkCoord(x, y, 0), solid_chunk());
+
+	for (const auto mode :
+	{ MeshingMode::PER_FACE, MeshingMode::GREEDY })
+	{
+		const size_t before = grid_triangles(world, registry, mode, false);
+		const size_t after = grid_triangles(world, registry, mode, true);
+		std::printf("%-8s triangles: isolated=%7zu with_borders=%7zu removed=%5.1f%%\n",
+				mode == MeshingMode::GREEDY ? "greedy" : "per-face", before,
+				after, 100.0 * (before - after) / before);
+	}
+
+	const int reps = 10000;
+	const auto start = std::chrono::steady_clock::now();
+	size_t sum = 0;
+	for (int i = 0; i < reps; i++)
+		sum += chunk_borders(world, ChunkCoord(4, 4, 0)).slices[0][i % 256];
+	const double us = std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now() - start).count() / reps;
+	std::printf("chunk_borders: %.2f us per chunk (%zu)\n", us, sum);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * chunk_map_bench.cpp
+ *
+ * Insert and lookup throughput of ChunkMap against the std::map World
+ * used before, for 10k to 1M loaded chunks. All entries share one Chunk
+ * so that only the containers are measured.
+ *
+ *   make -C bench && bench/build/chunk_map_bench
+ */
+
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+using OldMap = std::map<ChunkCoord, std::shared_ptr<Chunk>, Coord3DSort>;
+
+double mops(size_t ops, clock_type::duration d)
+{
+	return ops / std::chrono::duration<double, std::micro>(d).count();
+}
+
+// Coordinates of a loaded region around the origin, in random order.
+std::vector<ChunkCoord> region(size_t count, std::mt19937 &rng)
+{
+	const int side = (int) std::cbrt((double) count) + 1;
+	std::vector<ChunkCoord> coords;
+	coords.reserve(side * side * side);
+	for (int x = 0; x < side; x++)
+		for (int y = 0; y < side; y++)
+			for (int z = 0; z < side; z++)
+				coords.emplace_back(x - side / 2, y - side / 2, z - side / 2);
+	std::shuffle(coords.begin(), coords.end(), rng);
+	coords.resize(count);
+	return coords;
+}
+
+// Random inserts and erases checked against std::map.
+bool validate(std::mt19937 &rng)
+{
+	auto chunk = std::make_shared<Chunk>();
+	OldMap expected;
+	ChunkMap actual;
+	std::uniform_int_distribution<int> d(-40, 40);
+	for (int i = 0; i < 200000; i++)
+	{
+		const ChunkCoord c(d(rng), d(rng), d(rng) / 4);
+		if (rng() % 3 == 0)
+		{
+			expected.erase(c);
+			actual.erase(c);
+		}
+		else
+		{
+			expected.insert_or_assign(c, chunk);
+			actual.insert_or_assign(c, chunk);
+		}
+	}
+	if (expected.size() != actual.size())
+		return false;
+	for (const auto &kv : expected)
+		if (actual.find(kv.first) != kv.second.get())
+			return false;
+	size_t visited = 0;
+	bool ok = true;
+	actual.for_each([&](const ChunkCoord &c, const std::shared_ptr<Chunk>&)
+	{
+		visited++;
+		ok = ok && expected.count(c) == 1;
+	});
+	return ok && visited == expected.size();
+}
+
+void run(size_t count, std::mt19937 &rng)
+{
+	auto chunk = std::make_shared<Chunk>();
+	const auto coords = region(count, rng);
+	auto queries = coords;
+	std::shuffle(queries.begin(), queries.end(), rng);
+
+	OldMap old_map;
+	auto start = clock_type::now();
+	for (const auto &c : coords)
+		old_map.insert_or_assign(c, chunk);
+	const auto old_insert = clock_type::now() - start;
+
+	ChunkMap new_map;
+	start = clock_type::now();
+	for (const auto &c : coords)
+		new_map.insert_or_assign(c, chunk);
+	const auto new_insert = clock_type::now() - start;
+
+	// the old World::chunk(): find + shared_ptr copy into an optional
+	size_t hits = 0;
+	start = clock_type::now();
+	for (const auto &c : queries)
+	{
+		const auto it = old_map.find(c);
+		std::optional<std::shared_ptr<Chunk>> r;
+		if (it != old_map.end())
+			r = it->second;
+		hits += r.has_value();
+	}
+	const auto old_lookup = clock_type::now() - start;
+
+	start = clock_type::now();
+	for (const auto &c : queries)
+		hits += new_map.find(c) != nullptr;
+	const auto new_lookup = clock_type::now() - start;
+
+	std::printf("chunks=%8zu insert: map=%6.2f hash=%6.2f Mops/s  lookup: map=%6.2f hash=%6.2f Mops/s  (hits=%zu)\n",
+			count, mops(count, old_insert), mops(count, new_insert),
+			mops(count, old_lookup), mops(count, new_lookup), hits);
+}
+
+}
+
+int main()
+{
+	std::mt19937 rng(42);
+
+	if (!validate(rng))
+	{
+		std::printf("ChunkMap validation FAILED\n");
+		return 1;
+	}
+
+	for (size_t count :
+	{ 10000, 100000, 1000000 })
+		run(count, rng);
+
+	return 0;
+}
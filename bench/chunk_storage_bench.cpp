@@ -0,0 +1,136 @@
+/*
+ * chunk_storage_bench.cpp
+ *
+ * Bytes per chunk of generated terrain stored expanded, as a palette
+ * (Chunk::compact()) and run-length encoded, and the cost of random
+ * block_id() / set_block_id() calls on expanded and compact chunks.
+ *
+ *   make -C bench && bench/build/chunk_storage_bench [side]
+ */
+
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+struct Sizes
+{
+	size_t chunks = 0, uniform = 0, expanded = 0, compact = 0, rle = 0;
+	size_t by_bits[9] = {};
+};
+
+std::vector<Chunk> terrain(TerrainMode mode, int side)
+{
+	World world;
+	WorldGenerator(1, mode).generate_region(world,
+			ChunkCoord(-side / 2, -side / 2, -1),
+			ChunkCoord(side / 2 - 1, side / 2 - 1, 1));
+	std::vector<Chunk> chunks;
+	world.for_each_chunk([&chunks](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{
+		chunks.push_back(*c);
+	});
+	return chunks;
+}
+
+Sizes measure_sizes(std::vector<Chunk> &chunks)
+{
+	Sizes s;
+	for (auto &c : chunks)
+	{
+		s.chunks++;
+		s.expanded += sizeof(Chunk::ChunkData);
+		s.rle += rle_encode(c.data().data(), Chunk::block_count).size();
+		const auto blocks = c.expanded();
+		const PalettedBlocks palette(blocks.data(), Chunk::block_count);
+		s.by_bits[palette.bits()]++;
+		s.uniform += palette.uniform();
+
+		c.compact();
+		s.compact += c.storage_bytes();
+		if (c.expanded() != blocks)
+		{
+			std::printf("round trip FAILED\n");
+			std::exit(1);
+		}
+	}
+	return s;
+}
+
+template<typename F>
+double ns_per_op(size_t ops, F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+void access_cost(const char *name, std::vector<Chunk> chunks, bool compact)
+{
+	for (auto &c : chunks)
+	{
+		if (compact)
+			c.compact();
+		else
+			c.data();
+	}
+
+	const size_t n = 1 << 22;
+	std::mt19937 rng(3);
+	std::vector<std::uint32_t> picks(n);
+	for (auto &p : picks)
+		p = rng();
+
+	constexpr int cl = Chunk::chunk_length, ch = Chunk::chunk_height;
+	size_t sum = 0;
+	const double get_ns = ns_per_op(n, [&]
+	{
+		for (const auto p : picks)
+		{
+			const auto &c = chunks[(p >> 12) % chunks.size()];
+			sum += c.block_id((p >> 8) % cl, (p >> 4) % cl, p % ch);
+		}
+	});
+	// flip air and stone: ids already in the palette
+	const double set_ns = ns_per_op(n, [&]
+	{
+		for (const auto p : picks)
+		{
+			auto &c = chunks[(p >> 12) % chunks.size()];
+			c.set_block_id((p >> 8) % cl, (p >> 4) % cl, p % ch, p >> 31);
+		}
+	});
+	std::printf("  %-8s get=%6.2f ns set=%6.2f ns (%zu)\n", name, get_ns, set_ns,
+			sum);
+}
+
+void run(const char *name, TerrainMode mode, int side)
+{
+	auto chunks = terrain(mode, side);
+	const Sizes s = measure_sizes(chunks);
+	std::printf("%s: %zu chunks, bytes/chunk expanded=%zu compact=%.0f rle=%.0f"
+			" (uniform=%zu 1bit=%zu 2bit=%zu 4bit=%zu 8bit=%zu)\n", name,
+			s.chunks, s.expanded / s.chunks, (double) s.compact / s.chunks,
+			(double) s.rle / s.chunks, s.uniform, s.by_bits[1], s.by_bits[2],
+			s.by_bits[4], s.by_bits[8]);
+	access_cost("expanded", chunks, false);
+	access_cost("compact", chunks, true);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const int side = argc > 1 ? std::atoi(argv[1]) : 16;
+	run("density_3d", TerrainMode::DENSITY_3D, side);
+	run("heightmap", TerrainMode::HEIGHTMAP, side);
+	return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * collision_bench.cpp
+ *
+ * Collision resolutions per second of CollisionWorld on generated
+ * terrain: player-sized boxes start above random surface points and are
+ * moved every tick by walk_speed * dt in a random horizontal direction
+ * while falling, turning when they run into a hill. The same bodies are
+ * run by a sweep that looks up every block it tests with World::block_id;
+ * both must end in the same place, and no box may end up inside a solid
+ * block. Moving the bodies without any collision is timed too, as the
+ * cost of the simulation around the moves.
+ *
+ *   make -C bench && bench/build/collision_bench [bodies] [ticks] [walk_speed]
+ */
+
+#include "collision.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+// 12 x 12 chunk columns around the origin, z from -16 to 47
+constexpr int side = 12;
+constexpr std::int64_t half = side * Chunk::chunk_length / 2;
+constexpr std::int64_t z_min = -Chunk::chunk_height, z_max = 3
+		* Chunk::chunk_height;
+constexpr float dt = 1 / 60.0f;
+constexpr float fall_speed = 20;
+constexpr float body_half_width = 0.3f, body_height = 1.8f;
+constexpr float touch = 1e-4f;
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+// the highest non-air block of column (x, y), or z_min
+std::int64_t surface(const World &world, std::int64_t x, std::int64_t y)
+{
+	for (auto z = z_max - 1; z > z_min; z--)
+		if (world.block_id(x, y, z) != 0)
+			return z;
+	return z_min;
+}
+
+// the blocks box overlaps, by more than touching
+template<typename F>
+bool any_overlapped(const Aabb &box, F &&solid)
+{
+	std::int64_t min[3], max[3];
+	for (int a = 0; a < 3; a++)
+	{
+		min[a] = (std::int64_t) std::floor(box.min[a] + touch);
+		max[a] = (std::int64_t) std::ceil(box.max[a] - touch) - 1;
+	}
+	for (auto x = min[0]; x <= max[0]; x++)
+		for (auto y = min[1]; y <= max[1]; y++)
+			for (auto z = min[2]; z <= max[2]; z++)
+				if (solid(x, y, z))
+					return true;
+	return false;
+}
+
+// CollisionWorld::move() with a World::block_id lookup per block tested
+class LookupCollision
+{
+public:
+	LookupCollision(const World &world, const BlockRegistry &registry) :
+			world_(world), registry_(registry)
+	{
+	}
+
+	bool solid(std::int64_t x, std::int64_t y, std::int64_t z) const
+	{
+		return registry_[world_.block_id(x, y, z)].solid();
+	}
+
+	SweepResult move(Aabb &box, const float (&motion)[3]) const
+	{
+		SweepResult result;
+		for (const int axis :
+		{ 2, 0, 1 })
+		{
+			const float moved = sweep(box, axis, motion[axis]);
+			box.min[axis] += moved;
+			box.max[axis] += moved;
+			result.moved[axis] = moved;
+			result.blocked[axis] = moved != motion[axis];
+		}
+		return result;
+	}
+
+private:
+	float sweep(const Aabb &box, int axis, float distance) const
+	{
+		if (distance == 0)
+			return 0;
+		std::int64_t first, last;
+		const int step = distance > 0 ? 1 : -1;
+		if (step > 0)
+		{
+			first = (std::int64_t) std::ceil(box.max[axis] - touch);
+			last = (std::int64_t) std::ceil(box.max[axis] + distance) - 1;
+		}
+		else
+		{
+			first = (std::int64_t) std::floor(box.min[axis] + touch) - 1;
+			last = (std::int64_t) std::floor(box.min[axis] + distance);
+		}
+		if ((last - first) * step < 0)
+			return distance;
+		for (auto layer = first; layer != last + step; layer += step)
+		{
+			Aabb slab = box;
+			slab.min[axis] = layer;
+			slab.max[axis] = layer + 1;
+			if (any_overlapped(slab, [&](std::int64_t x, std::int64_t y,
+					std::int64_t z)
+			{	return solid(x, y, z);}))
+				return step > 0 ?
+						std::max(0.0f, layer - box.max[axis]) :
+						std::min(0.0f, layer + 1 - box.min[axis]);
+		}
+		return distance;
+	}
+
+	const World &world_;
+	const BlockRegistry &registry_;
+};
+
+struct Body
+{
+	Aabb box;
+	float heading;
+	std::minstd_rand rng;
+};
+
+// Runs ticks ticks of bodies with move(box, motion); returns the seconds
+// taken and counts the moves blocked horizontally.
+template<typename Move>
+double simulate(std::vector<Body> &bodies, int ticks, float walk_speed,
+		std::int64_t half_extent, Move &&move, size_t &blocked)
+{
+	std::uniform_real_distribution<float> angle(0, 6.2831853f);
+	std::uniform_int_distribution<int> turn(0, 29);
+	blocked = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < ticks; t++)
+		for (auto &b : bodies)
+		{
+			float motion[3] =
+			{ std::cos(b.heading) * walk_speed * dt, std::sin(b.heading)
+					* walk_speed * dt, -fall_speed * dt };
+			// stay inside the generated area
+			for (int a = 0; a < 2; a++)
+				if (b.box.min[a] + motion[a] < -half_extent + 1
+						|| b.box.max[a] + motion[a] > half_extent - 1)
+					motion[a] = -motion[a];
+			const SweepResult r = move(b.box, motion);
+			const bool stopped = r.blocked[0] || r.blocked[1];
+			blocked += stopped;
+			if (stopped || turn(b.rng) == 0)
+				b.heading = angle(b.rng);
+		}
+	return seconds_since(start);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t body_count = argc > 1 ? std::atol(argv[1]) : 1000;
+	const int ticks = argc > 2 ? std::atoi(argv[2]) : 200;
+	const float walk_speed = argc > 3 ? std::atof(argv[3]) : 100;
+
+	World world;
+	WorldGenerator(1, TerrainMode::HEIGHTMAP).generate_region(world,
+			ChunkCoord(-side / 2, -side / 2, -1),
+			ChunkCoord(side / 2 - 1, side / 2 - 1, 2));
+	world.for_each_chunk([](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{	c->compact();});
+	// air and one solid block id, as the renderer's registry
+	const auto registry = std::make_shared<const BlockRegistry>(
+			TextureStorage());
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> xy(-half + 16, half - 16);
+	std::uniform_real_distribution<float> angle(0, 6.2831853f);
+	std::vector<Body> bodies(body_count);
+	for (auto &b : bodies)
+	{
+		b.rng.seed(rng());
+		const float x = xy(rng), y = xy(rng);
+		const float z = surface(world, (std::int64_t) std::floor(x),
+				(std::int64_t) std::floor(y)) + 2;
+		b.box =
+		{
+		{ x - body_half_width, y - body_half_width, z },
+		{ x + body_half_width, y + body_half_width, z + body_height } };
+		b.heading = angle(rng);
+	}
+	// the cost of the simulation itself: no collision at all
+	std::vector<Body> free = bodies;
+	size_t free_blocked;
+	const double free_s = simulate(free, ticks, walk_speed, half,
+			[](Aabb &box, const float (&motion)[3])
+			{
+				SweepResult r;
+				for (int a = 0; a < 3; a++)
+				{
+					box.min[a] += motion[a];
+					box.max[a] += motion[a];
+					r.moved[a] = motion[a];
+					r.blocked[a] = false;
+				}
+				return r;
+			}, free_blocked);
+
+	CollisionWorld collision(world, registry);
+	std::vector<Body> fast = bodies;
+	size_t blocked;
+	const double fast_s = simulate(fast, ticks, walk_speed, half,
+			[&](Aabb &box, const float (&motion)[3])
+			{	return collision.move(box, motion);}, blocked);
+
+	LookupCollision lookup(world, *registry);
+	std::vector<Body> slow = bodies;
+	size_t slow_blocked;
+	const double slow_s = simulate(slow, ticks, walk_speed, half,
+			[&](Aabb &box, const float (&motion)[3])
+			{	return lookup.move(box, motion);}, slow_blocked);
+
+	size_t mismatches = 0, inside = 0;
+	for (size_t i = 0; i < body_count; i++)
+	{
+		for (int a = 0; a < 3; a++)
+			mismatches += fast[i].box.min[a] != slow[i].box.min[a]
+					|| fast[i].box.max[a] != slow[i].box.max[a];
+		inside += any_overlapped(fast[i].box,
+				[&](std::int64_t x, std::int64_t y, std::int64_t z)
+				{	return lookup.solid(x, y, z);});
+	}
+
+	const double moves = (double) body_count * ticks;
+	std::printf("bodies=%zu ticks=%d walk_speed=%.0f blocks_per_tick=%.2f horizontally_blocked=%.1f%% masks_built=%llu\n",
+			body_count, ticks, walk_speed, walk_speed * dt,
+			100.0 * blocked / moves, (unsigned long long) collision.masks_built());
+	std::printf("no collision:     moves_per_s=%10.0f ns_per_move=%.0f\n",
+			moves / free_s, free_s * 1e9 / moves);
+	std::printf("lookup per block: moves_per_s=%10.0f ns_per_move=%.0f\n",
+			moves / slow_s, slow_s * 1e9 / moves);
+	std::printf("CollisionWorld:   moves_per_s=%10.0f ns_per_move=%.0f\n",
+			moves / fast_s, fast_s * 1e9 / moves);
+	std::printf("mismatches=%zu bodies_inside_blocks=%zu\n", mismatches,
+			inside);
+	return mismatches != 0 || inside != 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * culling_bench.cpp
+ *
+ * Checks ChunkCuller against a few known cases, then measures it on a
+ * 64x64x4 grid of chunks while the camera turns around, reporting the
+ * time per chunk and how many chunks each test removes. The matrices
+ * are built here the same way as glm::perspective / glm::lookAt, so no
+ * GL context or glm is needed.
+ *
+ *   make -C bench && bench/build/culling_bench
+ */
+
+#include "culling.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace mycraft;
+
+namespace
+{
+
+// column-major 4x4, m[col * 4 + row]
+struct Mat4
+{
+	float m[16] = {};
+};
+
+Mat4 mul(const Mat4 &a, const Mat4 &b)
+{
+	Mat4 r;
+	for (int c = 0; c < 4; c++)
+		for (int row = 0; row < 4; row++)
+			for (int k = 0; k < 4; k++)
+				r.m[c * 4 + row] += a.m[k * 4 + row] * b.m[c * 4 + k];
+	return r;
+}
+
+Mat4 perspective(float fovy, float aspect, float near, float far)
+{
+	const float f = 1 / std::tan(fovy / 2);
+	Mat4 r;
+	r.m[0] = f / aspect;
+	r.m[5] = f;
+	r.m[10] = -(far + near) / (far - near);
+	r.m[11] = -1;
+	r.m[14] = -2 * far * near / (far - near);
+	return r;
+}
+
+void normalize(float (&v)[3])
+{
+	const float l = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	for (float &x : v)
+		x /= l;
+}
+
+void cross(const float (&a)[3], const float (&b)[3], float (&r)[3])
+{
+	r[0] = a[1] * b[2] - a[2] * b[1];
+	r[1] = a[2] * b[0] - a[0] * b[2];
+	r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// camera at eye looking along dir, z up
+Mat4 look_along(const float (&eye)[3], const float (&dir)[3])
+{
+	float f[3] =
+	{ dir[0], dir[1], dir[2] };
+	normalize(f);
+	const float up[3] =
+	{ 0, 0, 1 };
+	float s[3], u[3];
+	cross(f, up, s);
+	normalize(s);
+	cross(s, f, u);
+
+	Mat4 r;
+	for (int i = 0; i < 3; i++)
+	{
+		r.m[i * 4 + 0] = s[i];
+		r.m[i * 4 + 1] = u[i];
+		r.m[i * 4 + 2] = -f[i];
+	}
+	r.m[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+	r.m[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+	r.m[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+	r.m[15] = 1;
+	return r;
+}
+
+// the renderer's projection
+const Mat4 proj = perspective(50 * M_PI / 180, 800.0f / 600.0f, 1, 50);
+
+bool check(const char *what, bool ok)
+{
+	std::printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+bool validate()
+{
+	const float eye[3] =
+	{ 8, 8, 8 };
+	const float dir[3] =
+	{ 1, 0, 0 };
+	const Mat4 vp = mul(proj, look_along(eye, dir));
+	ChunkCuller culler(vp.m, eye, 100);
+
+	bool ok = true;
+	ok &= check("chunk containing the camera is drawn",
+			culler.test(ChunkCoord(0, 0, 0)) == CullResult::VISIBLE);
+	ok &= check("chunk ahead is drawn",
+			culler.test(ChunkCoord(2, 0, 0)) == CullResult::VISIBLE);
+	ok &= check("chunk behind is culled",
+			culler.test(ChunkCoord(-2, 0, 0)) == CullResult::OUTSIDE_FRUSTUM);
+	ok &= check("chunk far to the side is culled",
+			culler.test(ChunkCoord(1, 3, 0)) == CullResult::OUTSIDE_FRUSTUM);
+	ok &= check("chunk beyond the far plane is culled",
+			culler.test(ChunkCoord(4, 0, 0)) == CullResult::OUTSIDE_FRUSTUM);
+
+	ChunkCuller near(vp.m, eye, 20);
+	ok &= check("chunk beyond the view distance is culled",
+			near.test(ChunkCoord(2, 0, 0))
+					== CullResult::BEYOND_VIEW_DISTANCE);
+	ok &= check("counters add up",
+			culler.stats().tested == 5 && culler.stats().drawn == 2
+					&& culler.stats().culled_frustum == 3);
+	return ok;
+}
+
+}
+
+int main()
+{
+	if (!validate())
+		return 1;
+
+	const int side = 64, height = 4, frames = 64;
+	const float eye[3] =
+	{ 0, 0, 24 };
+	CullStats total;
+	const auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		const float angle = 2 * M_PI * frame / frames;
+		const float dir[3] =
+		{ std::cos(angle), std::sin(angle), -0.3f };
+		const Mat4 vp = mul(proj, look_along(eye, dir));
+		ChunkCuller culler(vp.m, eye, 64);
+		for (int x = -side / 2; x < side / 2; x++)
+			for (int y = -side / 2; y < side / 2; y++)
+				for (int z = -height / 2; z < height / 2; z++)
+					culler.test(ChunkCoord(x, y, z));
+		total.tested += culler.stats().tested;
+		total.culled_distance += culler.stats().culled_distance;
+		total.culled_frustum += culler.stats().culled_frustum;
+		total.drawn += culler.stats().drawn;
+	}
+	const double ns = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / total.tested;
+
+	std::printf("chunks/frame=%zu tested=%zu beyond_distance=%zu outside_frustum=%zu drawn=%zu (%.1f%% drawn) ns_per_chunk=%.2f\n",
+			total.tested / frames, total.tested, total.culled_distance,
+			total.culled_frustum, total.drawn,
+			100.0 * total.drawn / total.tested, ns);
+	return 0;
+}
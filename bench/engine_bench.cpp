@@ -0,0 +1,251 @@
+/*
+ * engine_bench.cpp
+ *
+ * Headless benchmark of the engine's hot paths (noise sampling, chunk
+ * generation, chunk meshing and World lookups), for tracking regressions
+ * from build to build. Needs no OpenGL or GLFW. Every input comes from
+ * the given seed, so runs are repeatable; the checksum column changes
+ * only when a path's output changes.
+ *
+ * Output is CSV on stdout, one row per benchmark:
+ *
+ *   benchmark,ops,ns_per_op,ops_per_s,checksum
+ *
+ * ns_per_op is the median over the repetitions.
+ *
+ *   make -C bench run
+ *   bench/build/engine_bench [--seed N] [--reps N] [--filter substring]
+ */
+
+#include "mesher.h"
+#include "perlin.h"
+#include "world.h"
+#include "worldgen.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+struct Options
+{
+	std::uint32_t seed = 1;
+	int reps = 5;
+	std::string filter;
+};
+
+Options options;
+
+// Runs f (which performs ops operations and returns a checksum of what
+// it computed) options.reps times and prints one CSV row.
+template<typename F>
+void measure(const std::string &name, size_t ops, F f)
+{
+	if (name.find(options.filter) == std::string::npos)
+		return;
+
+	std::vector<double> ns;
+	double checksum = 0;
+	for (int r = 0; r < options.reps; r++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		checksum = f();
+		const auto end = std::chrono::steady_clock::now();
+		ns.push_back(std::chrono::duration<double, std::nano>(
+				end - start).count() / ops);
+	}
+	std::sort(ns.begin(), ns.end());
+	const double median = ns[ns.size() / 2];
+	std::printf("%s,%zu,%.2f,%.1f,%.17g\n", name.c_str(), ops, median,
+			1e9 / median, checksum);
+	std::fflush(stdout);
+}
+
+void bench_noise()
+{
+	const size_t n = 1 << 18;
+	std::mt19937 rng(options.seed);
+	std::uniform_real_distribution<double> d(-512, 512);
+	std::vector<double> x(n), y(n), z(n), out(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		x[i] = d(rng);
+		y[i] = d(rng);
+		z[i] = d(rng) / 8;
+	}
+
+	auto sum = [&out]
+	{
+		double s = 0;
+		for (double v : out)
+			s += v;
+		return s;
+	};
+
+	measure("noise/perlin3d", n, [&]
+	{
+		for (size_t i = 0; i < n; i++)
+			out[i] = perlin::perlin3d(x[i], y[i], z[i]);
+		return sum();
+	});
+	measure("noise/perlin3d_batch", n, [&]
+	{
+		perlin::perlin3d_batch(x.data(), y.data(), z.data(), out.data(), n);
+		return sum();
+	});
+
+	constexpr int cs = Chunk::chunk_length, mz = Chunk::chunk_height;
+	const int images = 64;
+	measure("noise/fractal_chunk", images, [&]
+	{
+		for (int i = 0; i < images; i++)
+			perlin::perlin3d_fractal(out.data(), cs, cs, mz, 8, 4, x[i], y[i],
+					z[i]);
+		double s = 0;
+		for (int i = 0; i < cs * cs * mz; i++)
+			s += out[i];
+		return s;
+	});
+}
+
+// Chunk coordinates of a side x side x 2 region around the origin.
+std::vector<ChunkCoord> region(int side)
+{
+	std::vector<ChunkCoord> coords;
+	for (int x = 0; x < side; x++)
+		for (int y = 0; y < side; y++)
+			for (int z = -1; z <= 0; z++)
+				coords.emplace_back(x - side / 2, y - side / 2, z);
+	return coords;
+}
+
+double solid_blocks(const Chunk &chunk)
+{
+	double solid = 0;
+	for (const auto &b : chunk.data())
+		solid += b.block_id() != 0;
+	return solid;
+}
+
+void bench_worldgen()
+{
+	const auto coords = region(4);
+	for (const auto mode :
+	{ TerrainMode::DENSITY_3D, TerrainMode::HEIGHTMAP })
+	{
+		const WorldGenerator gen(options.seed, mode);
+		measure(mode == TerrainMode::HEIGHTMAP ?
+				"worldgen/heightmap_chunk" : "worldgen/density_chunk",
+				coords.size(), [&]
+				{
+					double solid = 0;
+					for (const auto &c : coords)
+						solid += solid_blocks(
+								gen.generate_chunk(c.x(), c.y(), c.z()));
+					return solid;
+				});
+	}
+}
+
+void bench_meshing()
+{
+	const BlockRegistry registry(standard_texture_storage());
+	const WorldGenerator gen(options.seed);
+	std::vector<Chunk> chunks;
+	for (const auto &c : region(4))
+		chunks.push_back(gen.generate_chunk(c.x(), c.y(), c.z()));
+
+	std::vector<MeshVertex> vertices(max_chunk_vertices);
+	for (const auto mode :
+	{ MeshingMode::PER_FACE, MeshingMode::GREEDY })
+	{
+		measure(mode == MeshingMode::GREEDY ?
+				"mesh/greedy_chunk" : "mesh/per_face_chunk", chunks.size(),
+				[&]
+				{
+					double total = 0;
+					for (const auto &chunk : chunks)
+						total += mesh_chunk(chunk, registry, mode,
+								vertices.data());
+					return total;
+				});
+	}
+}
+
+void bench_world()
+{
+	// lookups only look at the map, so every slot shares one chunk
+	const auto chunk = std::make_shared<Chunk>();
+	World world;
+	const int side = 64;
+	for (const auto &c : region(side))
+		world.set_chunk(c, chunk);
+
+	const size_t n = 1 << 20;
+	std::mt19937 rng(options.seed);
+	std::uniform_int_distribution<int> hit(-side / 2, side / 2 - 1);
+	std::uniform_int_distribution<int> miss(side, 4 * side);
+	std::uniform_int_distribution<int> hit_z(-1, 0);
+	std::vector<ChunkCoord> hits, misses;
+	for (size_t i = 0; i < n; i++)
+	{
+		hits.emplace_back(hit(rng), hit(rng), hit_z(rng));
+		misses.emplace_back(miss(rng), hit(rng), hit_z(rng));
+	}
+
+	measure("world/find_chunk_hit", n, [&]
+	{
+		double found = 0;
+		for (const auto &c : hits)
+			found += world.find_chunk(c) != nullptr;
+		return found;
+	});
+	measure("world/find_chunk_miss", n, [&]
+	{
+		double found = 0;
+		for (const auto &c : misses)
+			found += world.find_chunk(c) != nullptr;
+		return found;
+	});
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const bool has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--seed") && has_value)
+			options.seed = std::strtoul(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--reps") && has_value)
+			options.reps = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--filter") && has_value)
+			options.filter = argv[++i];
+		else
+		{
+			std::fprintf(stderr,
+					"usage: %s [--seed N] [--reps N] [--filter substring]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+
+	std::printf("# seed=%u reps=%d simd=%d\n", options.seed, options.reps,
+			(int) perlin::simd_level());
+	std::printf("benchmark,ops,ns_per_op,ops_per_s,checksum\n");
+	bench_noise();
+	bench_worldgen();
+	bench_meshing();
+	bench_world();
+	return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * fractal_noise_bench.cpp
+ *
+ * perlin3d_fractal / perlin2d_fractal against the previous
+ * perlin3d_image / perlin2d_image (copied below): time per image and
+ * heap bytes allocated per call, for chunk-sized and large images.
+ *
+ *   g++ -std=c++17 -O2 -Isrc bench/fractal_noise_bench.cpp src/perlin.cpp \
+ *       src/perlin_simd.cpp -o fractal_noise_bench
+ */
+
+#include "perlin.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace mycraft::perlin;
+
+namespace
+{
+
+// The implementations before the octave-accumulating API.
+std::unique_ptr<double[]> old_perlin3d_image(int x, int y, int z,
+		int cell_size, int layers, double origin_x, double origin_y,
+		double origin_z)
+{
+	std::unique_ptr<double[]> tmp(new double[x * y * z * layers]);
+	const auto a3 = y * z * layers;
+	const auto a2 = z * layers;
+	const auto a1 = layers;
+
+	for (int l = 0; l < layers; l++)
+		for (int i = 0; i < x; i++)
+			for (int j = 0; j < y; j++)
+				for (int k = 0; k < z; k++)
+				{
+					auto amplitude = 1.0 / std::pow(2, l);
+					auto frequency = std::pow(2, l);
+					auto period = cell_size / frequency;
+					tmp[i * a3 + j * a2 + k * a1 + l] = perlin3d(
+							(origin_x + i) / period, (origin_y + j) / period,
+							(origin_z + k) / period) * amplitude;
+				}
+
+	std::unique_ptr<double[]> result(new double[x * y * z]);
+	for (int i = 0; i < x * y * z; i++)
+		result[i] = 0;
+	for (int l = 0; l < layers; l++)
+		for (int i = 0; i < x; i++)
+			for (int j = 0; j < y; j++)
+				for (int k = 0; k < z; k++)
+					result[i * y * z + j * z + k] += tmp[i * a3 + j * a2
+							+ k * a1 + l];
+	for (int i = 0; i < x * y * z; i++)
+		result[i] /= layers;
+	return result;
+}
+
+std::unique_ptr<double[]> old_perlin2d_image(int height, int width,
+		int cell_size, int layers)
+{
+	std::unique_ptr<double[]> tmp(new double[height * width * layers]);
+	const auto a2 = width * layers;
+
+	for (int k = 0; k < layers; k++)
+		for (int i = 0; i < height; i++)
+			for (int j = 0; j < width; j++)
+			{
+				auto amplitude = 1.0 / std::pow(2, k);
+				auto frequency = std::pow(2, k);
+				auto period = cell_size / frequency;
+				tmp[i * a2 + j * layers + k] = perlin2d(i / period, j / period)
+						* amplitude;
+			}
+
+	std::unique_ptr<double[]> result(new double[height * width]);
+	for (int i = 0; i < height * width; i++)
+		result[i] = 0;
+	for (int k = 0; k < layers; k++)
+		for (int i = 0; i < height; i++)
+			for (int j = 0; j < width; j++)
+				result[i * width + j] += tmp[i * a2 + j * layers + k];
+	for (int i = 0; i < height * width; i++)
+		result[i] /= layers;
+	return result;
+}
+
+template<typename F>
+double time_ms(int reps, F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++)
+		f();
+	return std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count() / reps;
+}
+
+void report(const char *name, size_t points, int layers, double old_ms,
+		double new_ms, const double *a, const double *b)
+{
+	const size_t old_bytes = points * (layers + 1) * sizeof(double);
+	size_t mismatches = 0;
+	for (size_t i = 0; i < points; i++)
+		mismatches += std::memcmp(a + i, b + i, sizeof(double)) != 0;
+	std::printf("%-14s old: %9.3f ms %9zu B/call   new: %9.3f ms %3d B/call"
+			"   speedup=%.2fx  bit_mismatches=%zu\n", name, old_ms, old_bytes,
+			new_ms, 0, old_ms / new_ms, mismatches);
+}
+
+void bench3d(const char *name, int x, int y, int z, int reps)
+{
+	const int cell = 8, layers = 4;
+	const size_t points = (size_t) x * y * z;
+	std::unique_ptr<double[]> old_result;
+	std::vector<double> out(points);
+
+	const double old_ms = time_ms(reps, [&]
+	{	old_result = old_perlin3d_image(x, y, z, cell, layers, 100.5, -37, 12);});
+	const double new_ms = time_ms(reps, [&]
+	{	perlin3d_fractal(out.data(), x, y, z, cell, layers, 100.5, -37, 12);});
+	report(name, points, layers, old_ms, new_ms, old_result.get(), out.data());
+}
+
+void bench2d(const char *name, int h, int w, int reps)
+{
+	const int cell = 8, layers = 4;
+	const size_t points = (size_t) h * w;
+	std::unique_ptr<double[]> old_result;
+	std::vector<double> out(points);
+
+	const double old_ms = time_ms(reps, [&]
+	{	old_result = old_perlin2d_image(h, w, cell, layers);});
+	const double new_ms = time_ms(reps, [&]
+	{	perlin2d_fractal(out.data(), h, w, cell, layers);});
+	report(name, points, layers, old_ms, new_ms, old_result.get(), out.data());
+}
+
+}
+
+int main()
+{
+	bench3d("3d 16x16x16", 16, 16, 16, 200);
+	bench3d("3d 128x128x64", 128, 128, 64, 2);
+	bench2d("2d 16x16", 16, 16, 2000);
+	bench2d("2d 1024x1024", 1024, 1024, 2);
+	return 0;
+}
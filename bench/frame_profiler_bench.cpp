@@ -0,0 +1,92 @@
+/*
+ * frame_profiler_bench.cpp
+ *
+ * Cost of a ScopedTimer around a small piece of work: without a timer,
+ * with the profiler disabled (what every frame pays when the timings are
+ * compiled in but off) and enabled. Then prints the CSV and JSON dumps of
+ * a simulated run.
+ *
+ *   make -C bench && bench/build/frame_profiler_bench [iterations]
+ */
+
+#include "frame_profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+using namespace mycraft;
+
+namespace
+{
+
+// keeps the work from being optimised away
+volatile std::uint64_t sink;
+
+// a few ns of work, standing in for a frame stage
+inline void work(std::uint64_t &x)
+{
+	x = x * 6364136223846793005ull + 1442695040888963407ull;
+}
+
+template<typename F>
+double ns_per_iteration(size_t iterations, F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	std::uint64_t x = 1;
+	for (size_t i = 0; i < iterations; i++)
+		f(x);
+	sink = x;
+	return std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t iterations = argc > 1 ? std::atol(argv[1]) : 20000000;
+	FrameProfiler profiler;
+
+	const double bare = ns_per_iteration(iterations, [](std::uint64_t &x)
+	{	work(x);});
+	const double disabled = ns_per_iteration(iterations,
+			[&profiler](std::uint64_t &x)
+			{
+				ScopedTimer timer(profiler, FrameStage::MESHING);
+				work(x);
+			});
+	profiler.set_enabled(true);
+	const double enabled = ns_per_iteration(iterations / 10,
+			[&profiler](std::uint64_t &x)
+			{
+				ScopedTimer timer(profiler, FrameStage::MESHING);
+				work(x);
+			});
+	std::printf("no timer %.2f ns, disabled timer %.2f ns (+%.2f), enabled timer %.2f ns (+%.2f)\n",
+			bare, disabled, disabled - bare, enabled, enabled - bare);
+
+	// a minute of frames at 60 Hz with made-up stage times
+	profiler.reset();
+	std::mt19937 rng(1);
+	std::lognormal_distribution<double> us(6, 0.5);
+	for (int frame = 0; frame < 3600; frame++)
+	{
+		double total = 0;
+		for (size_t s = 0; s < static_cast<size_t>(FrameStage::FRAME); s++)
+		{
+			const double t = us(rng);
+			total += t;
+			profiler.record(static_cast<FrameStage>(s),
+					std::chrono::nanoseconds((std::int64_t) (t * 1e3)));
+		}
+		profiler.record(FrameStage::FRAME,
+				std::chrono::nanoseconds((std::int64_t) (total * 1e3)));
+	}
+	std::cout << profiler.overlay_text() << "\n\n";
+	profiler.write_csv(std::cout);
+	std::cout << '\n';
+	profiler.write_json(std::cout);
+	return 0;
+}
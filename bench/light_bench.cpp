@@ -0,0 +1,169 @@
+/*
+ * light_bench.cpp
+ *
+ * Times LightEngine on a generated world: initial lighting of every
+ * chunk (skylight and the light of a scattered emitting block), then
+ * single-block edits near the surface committed one at a time, each
+ * updating only the light around it. The incrementally lit world is
+ * checked block for block against the same blocks lit from scratch.
+ *
+ *   make -C bench && bench/build/light_bench [edits] [seed]
+ */
+
+#include "light.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+// 12 x 12 chunk columns around the origin, z from -16 to 47
+constexpr int side = 12;
+constexpr std::int64_t half = side * Chunk::chunk_length / 2;
+constexpr std::int64_t z_min = -Chunk::chunk_height, z_max = 3
+		* Chunk::chunk_height;
+
+// not in the texture storage; nothing meshes these worlds
+constexpr block_id_t lamp = 9;
+constexpr std::uint8_t lamp_light = 14;
+
+LightProperties properties()
+{
+	LightProperties p;
+	p.emission[lamp] = lamp_light;
+	return p;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<ChunkCoord> coords_of(const World &world)
+{
+	std::vector<ChunkCoord> coords;
+	world.for_each_chunk([&](const ChunkCoord &c, const std::shared_ptr<Chunk>&)
+	{	coords.push_back(c);});
+	return coords;
+}
+
+// the same blocks, without light
+World unlit_copy(const World &world)
+{
+	World copy;
+	world.for_each_chunk(
+			[&](const ChunkCoord &c, const std::shared_ptr<Chunk> &chunk)
+			{
+				auto blocks = std::make_shared<Chunk>(chunk->expanded());
+				blocks->compact();
+				copy.set_chunk(c, std::move(blocks));
+			});
+	return copy;
+}
+
+double light_all(World &world, LightEngine &light)
+{
+	const auto coords = coords_of(world);
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto &c : coords)
+		light.light_chunk(c);
+	const double s = seconds_since(start);
+	light.take_relit();
+	return s;
+}
+
+// the highest non-air block of column (x, y), or z_min
+std::int64_t surface(const World &world, std::int64_t x, std::int64_t y)
+{
+	for (auto z = z_max - 1; z > z_min; z--)
+		if (world.block_id(x, y, z) != 0)
+			return z;
+	return z_min;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t count = argc > 1 ? std::atol(argv[1]) : 20000;
+	const std::uint32_t seed = argc > 2 ? std::atoi(argv[2]) : 1;
+
+	World world;
+	WorldGenerator(1, TerrainMode::HEIGHTMAP).generate_region(world,
+			ChunkCoord(-side / 2, -side / 2, -1),
+			ChunkCoord(side / 2 - 1, side / 2 - 1, 2));
+
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<std::int64_t> xy(-half, half - 1);
+	// a lamp on the surface of every 16th column or so
+	for (int i = 0; i < side * side * 16; i++)
+	{
+		const auto x = xy(rng), y = xy(rng);
+		const auto z = surface(world, x, y) + 1;
+		CoordElem l[3];
+		Chunk *chunk = world.find_chunk(block_chunk(x, y, z, l));
+		if (chunk)
+			chunk->set_block_id(l[0], l[1], l[2], lamp);
+	}
+	world.for_each_chunk([](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{	c->compact();});
+
+	LightEngine light(world, properties());
+	auto visited = light.visited();
+	const double initial_s = light_all(world, light);
+	std::printf("initial: chunks=%zu chunks_per_s=%9.0f ms_per_chunk=%.3f visited_per_chunk=%.0f\n",
+			world.chunk_count(), world.chunk_count() / initial_s,
+			initial_s * 1e3 / world.chunk_count(),
+			(double) (light.visited() - visited) / world.chunk_count());
+
+	// dig, build and place lamps around the surface, one commit per edit
+	std::uniform_int_distribution<int> dz(-3, 2);
+	std::uniform_int_distribution<int> kind(0, 7);
+	std::vector<BlockEdit> edits(count);
+	for (auto &e : edits)
+	{
+		e.x = xy(rng);
+		e.y = xy(rng);
+		e.z = surface(world, e.x, e.y) + dz(rng);
+		const int k = kind(rng);
+		e.id = k < 3 ? 0 : k < 7 ? 1 : lamp;
+	}
+
+	WorldEdit edit;
+	size_t changed = 0, relit = 0;
+	visited = light.visited();
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto &e : edits)
+	{
+		edit.set_block(e.x, e.y, e.z, e.id);
+		const auto result = edit.commit(world, &light);
+		changed += result.blocks_changed;
+		relit += result.relit.size();
+	}
+	const double s = seconds_since(start);
+	std::printf("edits:   edits=%zu updates_per_s=%9.0f us_per_edit=%.2f blocks_changed=%zu visited_per_edit=%.0f relit_chunks_per_edit=%.2f\n",
+			count, count / s, s * 1e6 / count, changed,
+			(double) (light.visited() - visited) / count,
+			(double) relit / count);
+
+	World fresh = unlit_copy(world);
+	LightEngine fresh_light(fresh, properties());
+	light_all(fresh, fresh_light);
+	size_t mismatches = 0;
+	for (auto x = -half; x < half; x++)
+		for (auto y = -half; y < half; y++)
+			for (auto z = z_min; z < z_max; z++)
+				for (const auto channel :
+				{ LightChannel::SKY, LightChannel::BLOCK })
+					mismatches += light.light(channel, x, y, z)
+							!= fresh_light.light(channel, x, y, z);
+	std::printf("mismatches against lighting from scratch: %zu\n", mismatches);
+	return mismatches != 0;
+}
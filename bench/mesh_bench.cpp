@@ -0,0 +1,99 @@
+/*
+ * mesh_bench.cpp
+ *
+ * Compares the per-face and greedy mesher on a flat and a generated chunk.
+ * Headless (no OpenGL); build from the top directory with
+ *
+ *   make -C bench && bench/build/mesh_bench [iterations]
+ */
+
+#include "mesher.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+Chunk flat_chunk()
+{
+	Chunk::ChunkData blks;
+	for (int i = 0; i < Chunk::chunk_length; i++)
+		for (int j = 0; j < Chunk::chunk_length; j++)
+			for (int k = 0; k < Chunk::chunk_height; k++)
+			{
+				int id = k == Chunk::chunk_height - 1 ? 2 : 1;
+				blks[Chunk::convert_index(i, j, k)].set_block_id(id);
+			}
+	return Chunk(blks);
+}
+
+// Number of unit block faces covered by the quads in vertices.
+size_t covered_faces(const std::vector<MeshVertex> &vertices, size_t count)
+{
+	size_t faces = 0;
+	for (size_t q = 0; q < count; q += quad_vertices)
+	{
+		// extent along each axis; 0 along the face normal
+		int lo[3] = { 31, 31, 31 }, hi[3] = { 0, 0, 0 };
+		for (size_t c = q; c < q + quad_vertices; c++)
+		{
+			const int p[3] =
+			{ vertex_x(vertices[c]), vertex_y(vertices[c]), vertex_z(
+					vertices[c]) };
+			for (int a = 0; a < 3; a++)
+			{
+				lo[a] = std::min(lo[a], p[a]);
+				hi[a] = std::max(hi[a], p[a]);
+			}
+		}
+		size_t area = 1;
+		for (int a = 0; a < 3; a++)
+			area *= std::max(1, hi[a] - lo[a]);
+		faces += area;
+	}
+	return faces;
+}
+
+void run(const char *name, const Chunk &chunk, const BlockRegistry &registry,
+		int iterations)
+{
+	std::vector<MeshVertex> vertices(max_chunk_vertices);
+
+	for (const auto mode :
+	{ MeshingMode::PER_FACE, MeshingMode::GREEDY })
+	{
+		size_t count = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+			count = mesh_chunk(chunk, registry, mode, vertices.data());
+		const auto end = std::chrono::steady_clock::now();
+		const double us = std::chrono::duration<double, std::micro>(
+				end - start).count() / iterations;
+
+		std::printf("%-9s %-8s vertices=%6zu bytes=%7zu faces=%5zu mesh_us=%8.2f\n",
+				name, mode == MeshingMode::GREEDY ? "greedy" : "per-face",
+				count, count * sizeof(MeshVertex),
+				covered_faces(vertices, count), us);
+	}
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+	const BlockRegistry registry(standard_texture_storage());
+
+	run("flat", flat_chunk(), registry, iterations);
+
+	WorldGenerator gen;
+	run("generated", gen.generate_chunk(0, 0, 0), registry, iterations);
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * mesh_worker_bench.cpp
+ *
+ * Stress test for background meshing: marks hundreds of chunks dirty at
+ * once and reports the worst main-thread frame time, first with every
+ * mesh built on the main thread (the old lazy get_vertices() behaviour)
+ * and then with a MeshWorkerPool and a per-frame upload budget.
+ *
+ *   make -C bench && bench/build/mesh_worker_bench [chunks] \
+ *       [uploads_per_frame] [threads]
+ *
+ * Frames are paced at 60 Hz; only the main-thread work is counted as
+ * frame time. Also reports the resident mesh memory per chunk.
+ */
+
+#include "mesh_worker.h"
+#include "worldgen.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+constexpr auto frame_period = std::chrono::microseconds(16667);
+
+struct FrameStats
+{
+	double worst_ms = 0;
+	double total_ms = 0;
+	size_t frames = 0;
+
+	void add(clock_type::duration d)
+	{
+		const double ms = std::chrono::duration<double, std::milli>(d).count();
+		worst_ms = std::max(worst_ms, ms);
+		total_ms += ms;
+		frames++;
+	}
+
+	void print(const char *name) const
+	{
+		std::printf("%-12s frames=%5zu worst_frame_ms=%8.3f mean_frame_ms=%7.3f total_ms=%8.2f\n",
+				name, frames, worst_ms, total_ms / frames, total_ms);
+	}
+};
+
+void print_memory(const std::vector<MeshBuffer> &meshes)
+{
+	size_t bytes = 0;
+	for (const auto &m : meshes)
+		bytes += m.bytes();
+	const auto &pool = MeshPool::shared();
+	std::printf("mesh memory: %zu bytes/chunk resident (fixed array: %zu), pool in_use=%zu reserved=%zu free=%zu\n",
+			bytes / meshes.size(), max_chunk_vertices * sizeof(MeshVertex),
+			pool.bytes_in_use(), pool.bytes_reserved(), pool.bytes_free());
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t chunk_count = argc > 1 ? std::atoi(argv[1]) : 512;
+	const size_t budget = argc > 2 ? std::atoi(argv[2]) : 8;
+	const unsigned threads = argc > 3 ? std::atoi(argv[3]) : 0;
+
+	auto registry = std::make_shared<const BlockRegistry>(
+			standard_texture_storage());
+
+	WorldGenerator gen;
+	std::vector<Chunk> chunks;
+	std::vector<ChunkCoord> coords;
+	const int side = 32;
+	for (size_t i = 0; i < chunk_count; i++)
+	{
+		coords.emplace_back(i % side, i / side, 0);
+		chunks.push_back(gen.generate_chunk(coords.back().x(),
+				coords.back().y(), 0));
+	}
+	// stands in for the ChunkCaches the meshes are installed into
+	std::vector<MeshBuffer> gpu(chunk_count);
+
+	// everything meshed on the main thread during the first frame
+	{
+		for (auto &c : chunks)
+			c.modifyData();
+
+		FrameStats stats;
+		std::vector<MeshVertex> scratch(max_chunk_vertices);
+		const auto start = clock_type::now();
+		for (size_t i = 0; i < chunk_count; i++)
+		{
+			const size_t n = mesh_chunk(chunks[i], *registry, MeshingMode::GREEDY,
+					scratch.data());
+			gpu[i] = MeshBuffer::copy_of(scratch.data(), n);
+			chunks[i].set_changed(false);
+		}
+		stats.add(clock_type::now() - start);
+		stats.print("main-thread");
+	}
+
+	// worker pool, at most budget installs per frame
+	{
+		for (auto &c : chunks)
+			c.modifyData();
+
+		MeshWorkerPool pool(registry, threads);
+		FrameStats stats;
+		size_t installed = 0;
+		bool submitted = false;
+		while (installed < chunk_count)
+		{
+			const auto start = clock_type::now();
+			if (!submitted)
+			{
+				for (size_t i = 0; i < chunk_count; i++)
+				{
+					pool.submit(coords[i], i, chunks[i], ChunkBorders(),
+							MeshingMode::GREEDY);
+					chunks[i].set_changed(false);
+				}
+				submitted = true;
+			}
+			for (size_t n = 0; n < budget; n++)
+			{
+				const auto result = pool.poll();
+				if (!result)
+					break;
+				gpu[result->ticket] = std::move(result->vertices);
+				installed++;
+			}
+			stats.add(clock_type::now() - start);
+			std::this_thread::sleep_until(start + frame_period);
+		}
+
+		std::printf("worker pool: %zu threads, %zu uploads per frame\n",
+				pool.threads(), budget);
+		stats.print("worker-pool");
+	}
+	print_memory(gpu);
+
+
+	return 0;
+}
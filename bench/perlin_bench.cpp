@@ -0,0 +1,99 @@
+/*
+ * perlin_bench.cpp
+ *
+ * Throughput of perlin3d_batch at each SIMD level against the scalar
+ * perlin3d, and how far the vector results are from the scalar ones.
+ *
+ *   g++ -std=c++17 -O2 -Isrc bench/perlin_bench.cpp src/perlin.cpp \
+ *       src/perlin_simd.cpp -o perlin_bench
+ *
+ *   ./perlin_bench [samples]
+ */
+
+#include "perlin.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace mycraft::perlin;
+
+namespace
+{
+
+const char* level_name(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::AVX2:
+		return "avx2";
+	case SimdLevel::SSE2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t n = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+	// terrain-like sample points, including negative coordinates
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<double> d(-512, 512);
+	std::vector<double> x(n), y(n), z(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		x[i] = d(rng);
+		y[i] = d(rng);
+		z[i] = d(rng) / 8;
+	}
+
+	std::vector<double> reference(n), out(n);
+	const int reps = 5;
+	double scalar_s = 0;
+	for (int r = 0; r < reps; r++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < n; i++)
+			reference[i] = perlin3d(x[i], y[i], z[i]);
+		scalar_s += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+	}
+	std::printf("detected=%s\n", level_name(simd_level()));
+	std::printf("%-7s %8.2f Msamples/s\n", "perlin3d", reps * n / scalar_s / 1e6);
+
+	for (SimdLevel level :
+	{ SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 })
+	{
+		if (level > simd_level())
+			continue;
+
+		double s = 0;
+		for (int r = 0; r < reps; r++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			perlin3d_batch(x.data(), y.data(), z.data(), out.data(), n, level);
+			s += std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start).count();
+		}
+
+		double max_diff = 0;
+		size_t mismatches = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			max_diff = std::max(max_diff, std::fabs(out[i] - reference[i]));
+			mismatches += std::memcmp(&out[i], &reference[i], sizeof(double))
+					!= 0;
+		}
+		std::printf("%-8s %8.2f Msamples/s  speedup=%.2fx  max_diff=%g  bit_mismatches=%zu\n",
+				level_name(level), reps * n / s / 1e6, scalar_s / s, max_diff,
+				mismatches);
+	}
+	return 0;
+}
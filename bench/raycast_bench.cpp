@@ -0,0 +1,191 @@
+/*
+ * raycast_bench.cpp
+ *
+ * Rays per second of the voxel raycast over generated terrain: rays in
+ * random directions from eye height above random surface points, cast
+ * one at a time, in batches from one eye, and by a walk that looks every
+ * block up with World::block_id (one chunk map lookup per step). All
+ * three must agree, and a ray straight down must hit the surface block
+ * on its top face.
+ *
+ *   make -C bench && bench/build/raycast_bench [eyes] [rays_per_eye] [seed]
+ */
+
+#include "raycast.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+// 12 x 12 chunk columns around the origin, z from -16 to 47
+constexpr int side = 12;
+constexpr std::int64_t half = side * Chunk::chunk_length / 2;
+constexpr std::int64_t z_min = -Chunk::chunk_height, z_max = 3
+		* Chunk::chunk_height;
+constexpr float reach = 64;
+constexpr float eye_height = 1.7f;
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+// the highest non-air block of column (x, y), or z_min
+std::int64_t surface(const World &world, std::int64_t x, std::int64_t y)
+{
+	for (auto z = z_max - 1; z > z_min; z--)
+		if (world.block_id(x, y, z) != 0)
+			return z;
+	return z_min;
+}
+
+// the same traversal with a World::block_id lookup per block
+std::optional<RayHit> raycast_by_lookup(const World &world, const Ray &ray,
+		float max_distance)
+{
+	constexpr TexDir entered_face[3][2] =
+	{
+	{ TEX_XNEG, TEX_XPOS },
+	{ TEX_YNEG, TEX_YPOS },
+	{ TEX_ZNEG, TEX_ZPOS } };
+	constexpr double never = std::numeric_limits<double>::infinity();
+	const double length = std::sqrt(
+			(double) ray.direction[0] * ray.direction[0]
+					+ (double) ray.direction[1] * ray.direction[1]
+					+ (double) ray.direction[2] * ray.direction[2]);
+	std::int64_t block[3];
+	int step[3];
+	double next[3], delta[3];
+	int main_axis = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		const double o = ray.origin[a], d = ray.direction[a] / length;
+		block[a] = (std::int64_t) std::floor(o);
+		step[a] = d > 0 ? 1 : d < 0 ? -1 : 0;
+		delta[a] = step[a] ? 1 / std::abs(d) : never;
+		next[a] = step[a] > 0 ? (block[a] + 1 - o) / d :
+					step[a] < 0 ? (block[a] - o) / d : never;
+		if (std::abs(ray.direction[a]) > std::abs(ray.direction[main_axis]))
+			main_axis = a;
+	}
+	TexDir face = entered_face[main_axis][step[main_axis] < 0];
+	double t = 0;
+	for (;;)
+	{
+		const block_id_t id = world.block_id(block[0], block[1], block[2]);
+		if (id != 0)
+			return RayHit
+			{
+			{ block[0], block[1], block[2] }, id, face, (float) t };
+		const int a = next[0] < next[1] ?
+				(next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+		t = next[a];
+		if (t > max_distance)
+			return {};
+		next[a] += delta[a];
+		block[a] += step[a];
+		face = entered_face[a][step[a] < 0];
+	}
+}
+
+bool same(const std::optional<RayHit> &a, const std::optional<RayHit> &b)
+{
+	if (!a || !b)
+		return !a && !b;
+	return a->block[0] == b->block[0] && a->block[1] == b->block[1]
+			&& a->block[2] == b->block[2] && a->id == b->id
+			&& a->face == b->face && a->distance == b->distance;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t eyes = argc > 1 ? std::atol(argv[1]) : 2000;
+	const size_t per_eye = argc > 2 ? std::atol(argv[2]) : 256;
+	const std::uint32_t seed = argc > 3 ? std::atoi(argv[3]) : 1;
+
+	World world;
+	WorldGenerator(1, TerrainMode::HEIGHTMAP).generate_region(world,
+			ChunkCoord(-side / 2, -side / 2, -1),
+			ChunkCoord(side / 2 - 1, side / 2 - 1, 2));
+	world.for_each_chunk([](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{	c->compact();});
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> xy(-half + 8, half - 8);
+	std::normal_distribution<float> normal;
+	std::vector<Ray> rays(eyes * per_eye);
+	size_t surface_misses = 0;
+	for (size_t e = 0; e < eyes; e++)
+	{
+		const float x = xy(rng), y = xy(rng);
+		const auto top = surface(world, (std::int64_t) std::floor(x),
+				(std::int64_t) std::floor(y));
+		const float z = top + 1 + eye_height;
+		for (size_t r = 0; r < per_eye; r++)
+			rays[e * per_eye + r] =
+			{
+			{ x, y, z },
+			{ normal(rng), normal(rng), normal(rng) } };
+
+		const auto down = raycast(world, Ray
+		{
+		{ x, y, z },
+		{ 0, 0, -1 } }, reach);
+		surface_misses += !down || down->block[2] != top
+				|| down->face != TEX_ZPOS
+				|| std::abs(down->distance - eye_height) > 1e-4f;
+	}
+
+	std::vector<std::optional<RayHit>> single(rays.size()), batch(
+			rays.size()), lookup(rays.size());
+	size_t hits = 0;
+	double distance = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < rays.size(); i++)
+		lookup[i] = raycast_by_lookup(world, rays[i], reach);
+	const double lookup_s = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < rays.size(); i++)
+		single[i] = raycast(world, rays[i], reach);
+	const double single_s = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t e = 0; e < eyes; e++)
+		hits += raycast(world, &rays[e * per_eye], per_eye, reach,
+				&batch[e * per_eye]);
+	const double batch_s = seconds_since(start);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < rays.size(); i++)
+	{
+		mismatches += !same(single[i], batch[i]) || !same(single[i], lookup[i]);
+		if (single[i])
+			distance += single[i]->distance;
+	}
+
+	std::printf("rays=%zu hits=%zu mean_hit_distance=%.1f reach=%.0f\n",
+			rays.size(), hits, hits ? distance / hits : 0.0, reach);
+	std::printf("lookup per block: rays_per_s=%10.0f ns_per_ray=%.0f\n",
+			rays.size() / lookup_s, lookup_s * 1e9 / rays.size());
+	std::printf("raycast:          rays_per_s=%10.0f ns_per_ray=%.0f\n",
+			rays.size() / single_s, single_s * 1e9 / rays.size());
+	std::printf("raycast batched:  rays_per_s=%10.0f ns_per_ray=%.0f\n",
+			rays.size() / batch_s, batch_s * 1e9 / rays.size());
+	std::printf("mismatches=%zu surface_misses=%zu\n", mismatches,
+			surface_misses);
+	return mismatches != 0 || surface_misses != 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * region_bench.cpp
+ *
+ * Saves a region of generated chunks to region files, then loads them
+ * back through RegionStore with a cold page cache (pages dropped with
+ * posix_fadvise after an fsync) and with a warm one. Also checks that
+ * the loaded chunks match and that a second save writes nothing.
+ *
+ *   make -C bench && bench/build/region_bench [directory] [side]
+ */
+
+#include "region_file.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace mycraft;
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start)
+{
+	return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+void drop_page_cache(const std::string &directory)
+{
+	for (const auto &entry : std::filesystem::directory_iterator(directory))
+	{
+		const int fd = ::open(entry.path().c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+		::fdatasync(fd);
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+}
+
+// Loads every chunk of world from a fresh store and compares it.
+bool load_all(const std::string &directory, const World &world,
+		const char *name)
+{
+	RegionStore store(directory);
+	size_t loaded = 0, mismatched = 0;
+	const auto start = clock_type::now();
+	world.for_each_chunk(
+			[&](const ChunkCoord &c, const std::shared_ptr<Chunk> &chunk)
+			{
+				const auto stored = store.load(c);
+				loaded += stored != nullptr;
+				mismatched += !stored || stored->data() != chunk->data();
+			});
+	const double s = seconds_since(start);
+	std::printf("load %-5s chunks=%zu time_ms=%.2f chunks_per_s=%.0f mismatched=%zu\n",
+			name, loaded, s * 1e3, loaded / s, mismatched);
+	return mismatched == 0;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const std::string directory =
+			argc > 1 ? argv[1] : "/tmp/mycraft_region_bench";
+	const int side = argc > 2 ? std::atoi(argv[2]) : 24;
+	std::filesystem::remove_all(directory);
+
+	World world;
+	WorldGenerator(1, TerrainMode::HEIGHTMAP).generate_region(world,
+			ChunkCoord(-side / 2, -side / 2, -1),
+			ChunkCoord(side / 2 - 1, side / 2 - 1, 1));
+
+	// pretend half of the chunks were edited
+	size_t i = 0;
+	world.for_each_chunk([&i](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{
+		if (i++ % 2 == 0)
+			c->modifyData();
+	});
+
+	{
+		RegionStore store(directory);
+		auto start = clock_type::now();
+		const size_t saved = store.save_changed(world);
+		store.sync();
+		double s = seconds_since(start);
+		std::printf("save  changed=%zu of %zu time_ms=%.2f chunks_per_s=%.0f\n",
+				saved, world.chunk_count(), s * 1e3, saved / s);
+
+		start = clock_type::now();
+		const size_t again = store.save_changed(world);
+		std::printf("save  again: written=%zu\n", again);
+	}
+
+	// the unsaved half is not in the store; make every chunk stored
+	{
+		world.for_each_chunk([](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+		{
+			c->set_needs_save(true);
+		});
+		RegionStore store(directory);
+		store.save_changed(world);
+		store.sync();
+	}
+
+	drop_page_cache(directory);
+	bool ok = load_all(directory, world, "cold");
+	ok &= load_all(directory, world, "warm");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+/*
+ * streaming_sim.cpp
+ *
+ * Headless replay of a flight over generated terrain through
+ * ChunkStreamer, paced at 60 frames per second. A frame counts as a
+ * stall when a chunk within one chunk of the player is still missing.
+ * Reports stalls, the deepest load queue and how many chunks were
+ * resident, which must stay bounded however long the flight.
+ *
+ *   make -C bench && bench/build/streaming_sim [seconds] [speed] [heightmap]
+ *
+ * speed is in blocks per second (the renderer's walk_speed is 100).
+ */
+
+#include "chunk_streamer.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace mycraft;
+
+int main(int argc, char **argv)
+{
+	const double seconds = argc > 1 ? std::atof(argv[1]) : 6;
+	const double speed = argc > 2 ? std::atof(argv[2]) : 100;
+	const TerrainMode mode =
+			argc > 3 && !std::strcmp(argv[3], "heightmap") ?
+					TerrainMode::HEIGHTMAP : TerrainMode::DENSITY_3D;
+
+	auto world = std::make_shared<World>();
+	auto generator = std::make_shared<const WorldGenerator>(1, mode);
+	const StreamingConfig config;
+	ChunkStreamer streamer(world, generator, config);
+
+	const double dt = 1.0 / 60;
+	const int frames = (int) (seconds / dt);
+	std::vector<ChunkCoord> loaded, unloaded;
+	size_t stalls = 0, loads = 0, unloads = 0;
+	size_t max_pending = 0, max_resident = 0;
+	double worst_update_ms = 0;
+
+	// warm up at the start position, as the game does before the
+	// player can move
+	while (!streamer.loaded_around_center(config.load_radius))
+	{
+		streamer.update(0, 0, 20, loaded, unloaded);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	loaded.clear();
+
+	auto next_frame = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		// a wide curve with some climbing and sinking
+		const double t = frame * dt;
+		const double heading = 0.3 * t;
+		const double distance = speed * t;
+		const double x = distance * std::cos(heading);
+		const double y = distance * std::sin(heading);
+		const double z = 20 + 12 * std::sin(0.5 * t);
+
+		const auto start = std::chrono::steady_clock::now();
+		streamer.update(x, y, z, loaded, unloaded);
+		worst_update_ms = std::max(worst_update_ms,
+				std::chrono::duration<double, std::milli>(
+						std::chrono::steady_clock::now() - start).count());
+
+		loads += loaded.size();
+		unloads += unloaded.size();
+		loaded.clear();
+		unloaded.clear();
+		stalls += !streamer.loaded_around_center(1);
+		max_pending = std::max(max_pending, streamer.pending());
+		max_resident = std::max(max_resident, world->chunk_count());
+
+		next_frame += std::chrono::microseconds((long) (dt * 1e6));
+		std::this_thread::sleep_until(next_frame);
+	}
+
+	std::printf("mode=%s frames=%d speed=%.0f blocks/s load_radius=%d unload_radius=%d\n",
+			mode == TerrainMode::HEIGHTMAP ? "heightmap" : "density_3d",
+			frames, speed, config.load_radius, config.unload_radius);
+	std::printf("stalled_frames=%zu (%.1f%%) max_pending=%zu loads=%zu unloads=%zu\n",
+			stalls, 100.0 * stalls / frames, max_pending, loads, unloads);
+	std::printf("resident_chunks: max=%zu final=%zu (%zu KB of blocks) worst_update_ms=%.3f\n",
+			max_resident, world->chunk_count(),
+			max_resident * sizeof(Chunk::ChunkData) / 1024, worst_update_ms);
+	return 0;
+}
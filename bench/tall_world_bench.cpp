@@ -0,0 +1,137 @@
+/*
+ * tall_world_bench.cpp
+ *
+ * Memory and meshing time of a 256 block tall world (ChunkColumn::height)
+ * with the ground at z = 64, stored three ways:
+ *
+ *   dense      every section allocated and expanded
+ *   compact    every section allocated, palette-compressed
+ *   sectioned  WorldGenerator::generate_column: empty sections (the sky)
+ *              not allocated, the rest compressed
+ *
+ * Meshing covers every stored section, with its neighbour borders. The
+ * sectioned world is checked block for block against the dense one.
+ *
+ *   make -C bench && bench/build/tall_world_bench [side] [heightmap]
+ */
+
+#include "mesher.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr int ground_level = 64;
+
+struct Result
+{
+	size_t sections = 0;
+	size_t bytes = 0;
+	size_t vertices = 0;
+	double mesh_ms = 0;
+};
+
+Result measure(const World &world, const BlockRegistry &registry)
+{
+	Result r;
+	std::vector<ChunkCoord> coords;
+	world.for_each_chunk(
+			[&](const ChunkCoord &c, const std::shared_ptr<Chunk> &chunk)
+			{
+				coords.push_back(c);
+				r.bytes += sizeof(Chunk) + chunk->storage_bytes();
+			});
+	r.sections = coords.size();
+
+	// meshing expands compact chunks; mesh copies so that the stored
+	// form (and its byte count) is left alone
+	std::vector<MeshVertex> out(max_chunk_vertices);
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto &c : coords)
+	{
+		const Chunk chunk(*world.find_chunk(c));
+		const auto borders = chunk_borders(world, c);
+		r.vertices += mesh_chunk(chunk, registry, MeshingMode::GREEDY,
+				out.data(), &borders);
+	}
+	r.mesh_ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+	return r;
+}
+
+void print(const char *name, const Result &r, int columns)
+{
+	std::printf("%-9s sections=%5zu (%5.2f/column) bytes=%10zu (%7.0f/column) vertices=%8zu mesh_ms=%8.2f\n",
+			name, r.sections, (double) r.sections / columns, r.bytes,
+			(double) r.bytes / columns, r.vertices, r.mesh_ms);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const int side = argc > 1 ? std::atoi(argv[1]) : 8;
+	const auto mode =
+			argc > 2 && !std::strcmp(argv[2], "heightmap") ?
+					TerrainMode::HEIGHTMAP : TerrainMode::DENSITY_3D;
+	const int columns = side * side;
+	const WorldGenerator gen(1, mode, ground_level);
+	const BlockRegistry registry(standard_texture_storage());
+
+	World dense, compact, sectioned;
+	double dense_gen_s = 0, column_gen_s = 0;
+	for (int x = 0; x < side; x++)
+		for (int y = 0; y < side; y++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int s = 0; s < ChunkColumn::sections; s++)
+			{
+				auto chunk = std::make_shared<Chunk>(
+						gen.generate_chunk(x, y, s).expanded());
+				compact.set_chunk(ChunkCoord(x, y, s),
+						std::make_shared<Chunk>(*chunk));
+				dense.set_chunk(ChunkCoord(x, y, s), std::move(chunk));
+			}
+			auto end = std::chrono::steady_clock::now();
+			dense_gen_s += std::chrono::duration<double>(end - start).count();
+
+			start = std::chrono::steady_clock::now();
+			sectioned.set_column(x, y, gen.generate_column(x, y));
+			end = std::chrono::steady_clock::now();
+			column_gen_s += std::chrono::duration<double>(end - start).count();
+		}
+	auto compact_all = [](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{	c->compact();};
+	compact.for_each_chunk(compact_all);
+	sectioned.for_each_chunk(compact_all);
+
+	size_t mismatches = 0;
+	for (int x = 0; x < side; x++)
+		for (int y = 0; y < side; y++)
+		{
+			const auto column = sectioned.column(x, y);
+			for (int i = 0; i < Chunk::chunk_length; i++)
+				for (int j = 0; j < Chunk::chunk_length; j++)
+					for (int z = 0; z < ChunkColumn::height; z++)
+						mismatches += column.block_id(i, j, z)
+								!= dense.block_id(x * Chunk::chunk_length + i,
+										y * Chunk::chunk_length + j, z);
+		}
+
+	std::printf("%s terrain, %d x %d columns of %d blocks, ground at z=%d, mismatches=%zu\n",
+			mode == TerrainMode::HEIGHTMAP ? "heightmap" : "density",
+			side, side, ChunkColumn::height, ground_level, mismatches);
+	std::printf("generation: all sections %.2f ms/column, generate_column %.2f ms/column\n",
+			dense_gen_s * 1e3 / columns, column_gen_s * 1e3 / columns);
+	print("dense", measure(dense, registry), columns);
+	print("compact", measure(compact, registry), columns);
+	print("sectioned", measure(sectioned, registry), columns);
+	return mismatches != 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * texture_cache_bench.cpp
+ *
+ * Times the texture stage of startup on a synthetic atlas: decoding the
+ * png, building its mip chain and baking it (what a launch without a
+ * current cache does) against mapping the baked file (what every later
+ * launch does). Both read every byte they would upload. libpng stands in
+ * for SOIL's decoder. Also checks that the baked levels match the decoded
+ * ones and that touching the png makes the cache stale.
+ *
+ *   make -C bench && bench/build/texture_cache_bench [runs] [size]
+ */
+
+#include "texture_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <png.h>
+#include <random>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+// per tile a base colour with per-pixel noise, like a block atlas
+std::vector<std::uint8_t> make_atlas(std::uint32_t size)
+{
+	std::mt19937 rng(1);
+	std::vector<std::uint8_t> rgb((size_t) size * size * 3);
+	const std::uint32_t tile = size / atlas_tiles;
+	std::vector<std::uint8_t> base(atlas_tiles * atlas_tiles * 3);
+	for (auto &b : base)
+		b = rng() % 200 + 28;
+	for (std::uint32_t y = 0; y < size; y++)
+		for (std::uint32_t x = 0; x < size; x++)
+			for (int c = 0; c < 3; c++)
+				rgb[((size_t) y * size + x) * 3 + c] = (std::uint8_t) (base[((y
+						/ tile) * atlas_tiles + x / tile) * 3 + c] + rng() % 28);
+	return rgb;
+}
+
+void write_png(const std::string &path, const std::vector<std::uint8_t> &rgb,
+		std::uint32_t size)
+{
+	png_image image;
+	std::memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	image.width = size;
+	image.height = size;
+	image.format = PNG_FORMAT_RGB;
+	if (!png_image_write_to_file(&image, path.c_str(), 0, rgb.data(), 0,
+			nullptr))
+	{
+		std::fprintf(stderr, "%s: %s\n", path.c_str(), image.message);
+		std::exit(1);
+	}
+}
+
+std::vector<std::uint8_t> read_png(const std::string &path,
+		std::uint32_t &width, std::uint32_t &height)
+{
+	png_image image;
+	std::memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&image, path.c_str()))
+	{
+		std::fprintf(stderr, "%s: %s\n", path.c_str(), image.message);
+		std::exit(1);
+	}
+	image.format = PNG_FORMAT_RGB;
+	std::vector<std::uint8_t> rgb(PNG_IMAGE_SIZE(image));
+	png_image_finish_read(&image, nullptr, rgb.data(), 0, nullptr);
+	width = image.width;
+	height = image.height;
+	return rgb;
+}
+
+// stands in for the upload reading the levels
+std::uint64_t checksum(const std::vector<TextureLevel> &levels)
+{
+	std::uint64_t sum = 0;
+	for (const auto &level : levels)
+		for (size_t i = 0; i < level.bytes(); i++)
+			sum = sum * 31 + level.pixels[i];
+	return sum;
+}
+
+double median(std::vector<double> v)
+{
+	std::sort(v.begin(), v.end());
+	return v[v.size() / 2];
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const int runs = argc > 1 ? std::atoi(argv[1]) : 20;
+	const std::uint32_t size = argc > 2 ? std::atoi(argv[2]) : 256;
+
+	const auto dir = std::filesystem::temp_directory_path()
+			/ "mycraft_texture_cache_bench";
+	std::filesystem::create_directories(dir);
+	const std::string png = (dir / "texture.png").string();
+	const std::string baked = (dir / "texture.baked").string();
+	write_png(png, make_atlas(size), size);
+
+	std::vector<double> decode_ms, mapped_ms;
+	std::uint64_t decoded_sum = 0, mapped_sum = 0;
+	size_t levels = 0, baked_bytes = 0;
+	for (int run = 0; run < runs; run++)
+	{
+		std::filesystem::remove(baked);
+
+		auto start = std::chrono::steady_clock::now();
+		const auto stamp = source_stamp(png);
+		if (BakedTexture::open(baked, stamp))
+		{
+			std::fprintf(stderr, "cache hit without a cache\n");
+			return 1;
+		}
+		std::uint32_t w, h;
+		const auto rgb = read_png(png, w, h);
+		const MipChain chain(rgb.data(), w, h);
+		bake_texture(baked, *stamp, chain);
+		decoded_sum = checksum(chain.levels());
+		decode_ms.push_back(ms_since(start));
+		levels = chain.levels().size();
+
+		start = std::chrono::steady_clock::now();
+		const auto texture = BakedTexture::open(baked, source_stamp(png));
+		if (!texture)
+		{
+			std::fprintf(stderr, "baked texture did not open\n");
+			return 1;
+		}
+		mapped_sum = checksum(texture->levels());
+		mapped_ms.push_back(ms_since(start));
+		baked_bytes = std::filesystem::file_size(baked);
+	}
+
+	// a newer png invalidates the cache
+	std::filesystem::last_write_time(png,
+			std::filesystem::last_write_time(png) + std::chrono::seconds(1));
+	const bool stale_rejected = !BakedTexture::open(baked, source_stamp(png));
+
+	std::printf("atlas %ux%u, %zu levels, %zu bytes baked\n", size, size,
+			levels, baked_bytes);
+	std::printf("decode + mips + bake  best %.3f ms  median %.3f ms\n",
+			*std::min_element(decode_ms.begin(), decode_ms.end()),
+			median(decode_ms));
+	std::printf("mapped baked texture  best %.3f ms  median %.3f ms\n",
+			*std::min_element(mapped_ms.begin(), mapped_ms.end()),
+			median(mapped_ms));
+	std::printf("levels match: %s, stale cache rejected: %s\n",
+			decoded_sum == mapped_sum ? "yes" : "NO",
+			stale_rejected ? "yes" : "NO");
+
+	std::filesystem::remove_all(dir);
+	return decoded_sum == mapped_sum && stale_rejected ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * world_edit_bench.cpp
+ *
+ * Applies 1M random block edits to a generated world and reports edits
+ * per second and the re-meshes they trigger: first with a direct
+ * Chunk::modifyData() per edit (no batching, every neighbour of a dirty
+ * chunk has to be assumed dirty as well), then through WorldEdit in
+ * batches of several sizes (one batch per frame, one re-mesh per affected
+ * chunk and batch). Also times box and sphere fills, and checks that the
+ * batched world ends up identical to the direct one.
+ *
+ *   make -C bench && bench/build/world_edit_bench [edits] [seed]
+ */
+
+#include "world_edit.h"
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+// 16 x 16 chunk columns around the origin, z from -16 to 47
+constexpr int side = 16;
+constexpr std::int64_t half = side * Chunk::chunk_length / 2;
+constexpr std::int64_t z_min = -Chunk::chunk_height, z_max = 3
+		* Chunk::chunk_height;
+
+World make_world()
+{
+	World world;
+	WorldGenerator(1, TerrainMode::HEIGHTMAP).generate_region(world,
+			ChunkCoord(-side / 2, -side / 2, -1),
+			ChunkCoord(side / 2 - 1, side / 2 - 1, 2));
+	world.for_each_chunk([](const ChunkCoord&, const std::shared_ptr<Chunk> &c)
+	{	c->compact();});
+	return world;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+void direct(World &world, const std::vector<BlockEdit> &edits)
+{
+	std::unordered_set<std::uint64_t> dirty;
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto &e : edits)
+	{
+		CoordElem l[3];
+		const auto c = block_chunk(e.x, e.y, e.z, l);
+		Chunk *chunk = world.find_chunk(c);
+		if (!chunk)
+		{
+			auto created = std::make_shared<Chunk>();
+			chunk = created.get();
+			world.set_chunk(c, std::move(created));
+		}
+		chunk->modifyData()[Chunk::convert_index(l[0], l[1], l[2])] = Block(
+				e.id);
+		dirty.insert(pack_chunk_coord(c));
+	}
+	const double s = seconds_since(start);
+	std::printf("%-22s edits=%zu edits_per_s=%11.0f dirty_chunks=%6zu remeshes=%7zu (incl. 6 neighbours each)\n",
+			"modifyData per edit", edits.size(), edits.size() / s,
+			dirty.size(), dirty.size() * 7);
+}
+
+void batched(World &world, const std::vector<BlockEdit> &edits, size_t batch)
+{
+	WorldEdit edit;
+	size_t remeshes = 0, changed = 0, created = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < edits.size(); i += batch)
+	{
+		edit.apply(edits.data() + i, std::min(batch, edits.size() - i));
+		const auto result = edit.commit(world);
+		remeshes += result.remesh.size();
+		changed += result.blocks_changed;
+		created += result.created.size();
+	}
+	const double s = seconds_since(start);
+	char name[64];
+	std::snprintf(name, sizeof(name), "WorldEdit batch=%zu", batch);
+	std::printf("%-22s edits=%zu edits_per_s=%11.0f blocks_changed=%zu created=%zu remeshes=%7zu (%.3f per edit)\n",
+			name, edits.size(), edits.size() / s, changed, created, remeshes,
+			(double) remeshes / edits.size());
+}
+
+size_t mismatches(const World &a, const World &b)
+{
+	size_t n = 0;
+	for (auto x = -half; x < half; x++)
+		for (auto y = -half; y < half; y++)
+			for (auto z = z_min; z < z_max; z++)
+				n += a.block_id(x, y, z) != b.block_id(x, y, z);
+	return n;
+}
+
+void fills()
+{
+	World world = make_world();
+	WorldEdit edit;
+
+	auto start = std::chrono::steady_clock::now();
+	edit.fill_box(-32, -32, -16, 31, 31, 47, 2);
+	const size_t box = edit.size();
+	auto result = edit.commit(world);
+	double s = seconds_since(start);
+	std::printf("fill_box 64^3           blocks=%zu blocks_per_s=%11.0f edited_chunks=%zu remeshes=%zu\n",
+			box, box / s, result.edited.size(), result.remesh.size());
+
+	start = std::chrono::steady_clock::now();
+	edit.fill_sphere(0, 0, 8, 24, 0);
+	const size_t sphere = edit.size();
+	result = edit.commit(world);
+	s = seconds_since(start);
+	std::printf("fill_sphere r=24        blocks=%zu blocks_per_s=%11.0f edited_chunks=%zu remeshes=%zu\n",
+			sphere, sphere / s, result.edited.size(), result.remesh.size());
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const size_t count = argc > 1 ? std::atol(argv[1]) : 1000000;
+	const std::uint32_t seed = argc > 2 ? std::atoi(argv[2]) : 1;
+
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<std::int64_t> xy(-half, half - 1);
+	std::uniform_int_distribution<std::int64_t> z(z_min, z_max - 1);
+	std::uniform_int_distribution<int> id(0, 3);
+	std::vector<BlockEdit> edits(count);
+	for (auto &e : edits)
+		e =
+		{	xy(rng), xy(rng), z(rng), (block_id_t) id(rng)};
+
+	World reference = make_world();
+	std::printf("world: %zu chunks\n", reference.chunk_count());
+	direct(reference, edits);
+
+	for (const size_t batch :
+	{ (size_t) 1, (size_t) 64, (size_t) 4096, count })
+	{
+		World world = make_world();
+		batched(world, edits, batch);
+		if (batch == count)
+			std::printf("mismatches against modifyData: %zu\n",
+					mismatches(world, reference));
+	}
+
+	fills();
+	return 0;
+}
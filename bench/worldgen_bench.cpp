@@ -0,0 +1,61 @@
+/*
+ * worldgen_bench.cpp
+ *
+ * Chunks generated per second by WorldGenerator::generate_region for
+ * increasing thread counts, for the 3D density and the heightmap path.
+ *
+ *   make -C bench && bench/build/worldgen_bench [region_side] [seed]
+ */
+
+#include "worldgen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+
+using namespace mycraft;
+
+namespace
+{
+
+void run(TerrainMode mode, const char *name, int side, std::uint32_t seed)
+{
+	const WorldGenerator gen(seed, mode);
+	const ChunkCoord min(-side / 2, -side / 2, -1);
+	const ChunkCoord max(min.x() + side - 1, min.y() + side - 1, 0);
+	const size_t chunks = (size_t) side * side * 2;
+
+	// sanity: generation is a pure function of seed and coordinates
+	const bool same = gen.generate_chunk(3, -2, 0).data()
+			== WorldGenerator(seed, mode).generate_chunk(3, -2, 0).data();
+	const bool differs = gen.generate_chunk(3, -2, 0).data()
+			!= WorldGenerator(seed + 1, mode).generate_chunk(3, -2, 0).data();
+	std::printf("%s: deterministic=%d seed_dependent=%d\n", name, same,
+			differs);
+
+	const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads = 1; threads <= hw * 2; threads *= 2)
+	{
+		World world;
+		const auto start = std::chrono::steady_clock::now();
+		gen.generate_region(world, min, max, threads);
+		const double s = std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+		std::printf("%s: threads=%2u chunks=%zu time_s=%.3f chunks_per_s=%.1f us_per_chunk=%.1f\n",
+				name, threads, world.chunk_count(), s, chunks / s,
+				s * 1e6 / chunks);
+	}
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const int side = argc > 1 ? std::atoi(argv[1]) : 8;
+	const std::uint32_t seed = argc > 2 ? std::atoi(argv[2]) : 1;
+
+	run(TerrainMode::DENSITY_3D, "density_3d", side, seed);
+	run(TerrainMode::HEIGHTMAP, "heightmap", side, seed);
+	return 0;
+}
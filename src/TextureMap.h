@@ -47,7 +47,8 @@ public:
 	};
 
 	 texture_id_t append(TextureMap map);
-	 const TextureMap& texture(texture_id_t tex_id) {return textures_.at(tex_id);}
+	 const TextureMap& texture(texture_id_t tex_id) const {return textures_.at(tex_id);}
+	 size_t size() const {return textures_.size();}
 
 private:
 	std::vector<TextureMap> textures_;
@@ -33,4 +33,14 @@ private:
 	block_id_t block_id_;
 };
 
+inline bool operator==(const Block &b1, const Block &b2)
+{
+	return b1.block_id() == b2.block_id();
+}
+
+inline bool operator!=(const Block &b1, const Block &b2)
+{
+	return !(b1 == b2);
+}
+
 }
@@ -0,0 +1,39 @@
+#include "block_registry.h"
+
+using namespace mycraft;
+
+namespace
+{
+
+std::uint8_t pack_tile(const TextureMapCoord &coord)
+{
+	return (std::uint8_t) ((coord.first.first & 15)
+			| (coord.first.second & 15) << 4);
+}
+
+}
+
+BlockRegistry::BlockRegistry(const TextureStorage &ts)
+{
+	for (size_t id = 0; id < blocks_.size(); id++)
+	{
+		auto &info = blocks_[id];
+		info.tiles.fill(0);
+		info.emission = 0;
+		if (id == 0)
+		{
+			info.flags = BlockInfo::AIR;
+			continue;
+		}
+		info.flags = BlockInfo::OPAQUE | BlockInfo::SOLID;
+		if (id > ts.size())
+			continue;
+		const auto &tex = ts.texture(id - 1);
+		info.tiles[TEX_XNEG] = pack_tile(tex.xneg());
+		info.tiles[TEX_YNEG] = pack_tile(tex.yneg());
+		info.tiles[TEX_XPOS] = pack_tile(tex.xpos());
+		info.tiles[TEX_YPOS] = pack_tile(tex.ypos());
+		info.tiles[TEX_ZNEG] = pack_tile(tex.zneg());
+		info.tiles[TEX_ZPOS] = pack_tile(tex.zpos());
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "block.h"
+#include "TextureMap.h"
+
+namespace mycraft
+{
+
+enum TexDir
+{
+	TEX_XNEG, TEX_YNEG, TEX_XPOS, TEX_YPOS, TEX_ZNEG, TEX_ZPOS
+};
+
+// What the engine needs to know about one block id, in 8 bytes so that
+// eight share a cache line.
+struct BlockInfo
+{
+	// atlas tile of each face by TexDir: x in the low 4 bits, y in the
+	// high 4 (the layout of the tile bits of a MeshVertex)
+	std::array<std::uint8_t, 6> tiles;
+	std::uint8_t flags;
+	// block light it gives off, 0 .. ChunkLight::max_level
+	std::uint8_t emission;
+
+	enum : std::uint8_t
+	{
+		AIR = 1,    // nothing there: no faces, no collision
+		OPAQUE = 2, // hides the faces against it, stops light
+		SOLID = 4   // collides
+	};
+
+	bool air() const
+	{
+		return flags & AIR;
+	}
+
+	bool opaque() const
+	{
+		return flags & OPAQUE;
+	}
+
+	bool solid() const
+	{
+		return flags & SOLID;
+	}
+
+	int tile_x(TexDir face) const
+	{
+		return tiles[face] & 15;
+	}
+
+	int tile_y(TexDir face) const
+	{
+		return tiles[face] >> 4;
+	}
+};
+
+static_assert(sizeof(BlockInfo) == 8, "BlockInfo must stay 8 bytes");
+
+// A flat table of BlockInfo over every block_id_t, built once, so that
+// lookups in the meshing and culling loops are a single unchecked index.
+// Id 0 is air; id n > 0 is an opaque, solid block textured by texture
+// n - 1 of the TextureStorage (ids beyond it use tile (0, 0)).
+class BlockRegistry
+{
+public:
+	// only air and untextured blocks
+	BlockRegistry() :
+			BlockRegistry(TextureStorage())
+	{
+	}
+
+	explicit BlockRegistry(const TextureStorage &ts);
+
+	const BlockInfo& operator[](block_id_t id) const
+	{
+		return blocks_[id];
+	}
+
+	void set(block_id_t id, const BlockInfo &info)
+	{
+		blocks_[id] = info;
+	}
+
+private:
+	alignas(64) std::array<BlockInfo, 256> blocks_;
+};
+
+}
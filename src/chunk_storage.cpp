@@ -0,0 +1,133 @@
+#include "chunk_storage.h"
+
+using namespace mycraft;
+
+PalettedBlocks::PalettedBlocks(std::size_t count, block_id_t fill) :
+		count_(count), palette_(1, fill)
+{
+}
+
+PalettedBlocks::PalettedBlocks(const Block *blocks, std::size_t count) :
+		count_(count)
+{
+	// palette in order of first appearance
+	bool seen[256] = {};
+	for (std::size_t i = 0; i < count; i++)
+	{
+		const block_id_t id = blocks[i].block_id();
+		if (!seen[id])
+		{
+			seen[id] = true;
+			palette_.push_back(id);
+		}
+	}
+	if (palette_.empty())
+		palette_.push_back(0);
+	palette_.shrink_to_fit();
+
+	bits_ = bits_for(palette_.size());
+	if (bits_ == 0)
+		return;
+
+	std::uint8_t index_of[256] = {};
+	for (std::size_t p = 0; p < palette_.size(); p++)
+		index_of[palette_[p]] = p;
+	words_.assign((count * bits_ + 63) / 64, 0);
+	for (std::size_t i = 0; i < count; i++)
+		set_index(i, index_of[blocks[i].block_id()]);
+}
+
+unsigned PalettedBlocks::bits_for(std::size_t palette_size)
+{
+	unsigned bits = 0;
+	while ((std::size_t(1) << bits) < palette_size)
+		bits = bits == 0 ? 1 : bits * 2;
+	return bits;
+}
+
+std::size_t PalettedBlocks::palette_index(block_id_t id) const
+{
+	for (std::size_t p = 0; p < palette_.size(); p++)
+		if (palette_[p] == id)
+			return p;
+	return palette_.size();
+}
+
+void PalettedBlocks::set_index(std::size_t i, std::size_t index)
+{
+	// bits_ divides 64, so an index never straddles two words
+	const std::size_t bit = i * bits_;
+	const std::uint64_t mask = ((std::uint64_t(1) << bits_) - 1)
+			<< (bit % 64);
+	auto &word = words_[bit / 64];
+	word = (word & ~mask) | ((std::uint64_t) index << (bit % 64));
+}
+
+void PalettedBlocks::repack(unsigned bits)
+{
+	std::vector<std::uint64_t> old;
+	old.swap(words_);
+	const unsigned old_bits = bits_;
+
+	bits_ = bits;
+	words_.assign((count_ * bits_ + 63) / 64, 0);
+	if (old_bits == 0)
+		return; // every index was 0
+	for (std::size_t i = 0; i < count_; i++)
+	{
+		const std::size_t bit = i * old_bits;
+		set_index(i, (old[bit / 64] >> (bit % 64)) & ((1u << old_bits) - 1));
+	}
+}
+
+void PalettedBlocks::set(std::size_t i, block_id_t id)
+{
+	std::size_t index = palette_index(id);
+	if (index == palette_.size())
+	{
+		palette_.push_back(id);
+		const unsigned bits = bits_for(palette_.size());
+		if (bits != bits_)
+			repack(bits);
+	}
+	if (bits_ != 0)
+		set_index(i, index);
+}
+
+void PalettedBlocks::expand(Block *out) const
+{
+	for (std::size_t i = 0; i < count_; i++)
+		out[i].set_block_id(get(i));
+}
+
+std::vector<std::uint8_t> mycraft::rle_encode(const Block *blocks,
+		std::size_t count)
+{
+	std::vector<std::uint8_t> out;
+	for (std::size_t i = 0; i < count;)
+	{
+		const block_id_t id = blocks[i].block_id();
+		std::size_t run = 1;
+		while (i + run < count && run < 256 && blocks[i + run].block_id() == id)
+			run++;
+		out.push_back(run - 1);
+		out.push_back(id);
+		i += run;
+	}
+	return out;
+}
+
+bool mycraft::rle_decode(const std::uint8_t *data, std::size_t size,
+		Block *out, std::size_t count)
+{
+	std::size_t n = 0;
+	for (std::size_t i = 0; i + 1 < size; i += 2)
+	{
+		const std::size_t run = data[i] + 1;
+		if (n + run > count)
+			return false;
+		for (std::size_t r = 0; r < run; r++)
+			out[n++].set_block_id(data[i + 1]);
+	}
+	return n == count && size % 2 == 0;
+}
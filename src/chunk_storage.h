@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "block.h"
+
+namespace mycraft
+{
+
+// Compact form of a chunk's blocks: a palette of the distinct block ids
+// and one bit-packed palette index per block, 0, 1, 2, 4 or 8 bits wide.
+// A chunk made of a single block id (all air, all stone) has no indices
+// at all. get() and set() work in place; set() widens the indices when
+// the palette outgrows them.
+class PalettedBlocks
+{
+public:
+	PalettedBlocks() = default;
+	// count blocks, all of id fill.
+	explicit PalettedBlocks(std::size_t count, block_id_t fill = 0);
+	PalettedBlocks(const Block *blocks, std::size_t count);
+
+	void expand(Block *out) const;
+
+	block_id_t get(std::size_t i) const
+	{
+		if (bits_ == 0)
+			return palette_[0];
+		const std::size_t bit = i * bits_;
+		const std::uint64_t word = words_[bit / 64] >> (bit % 64);
+		return palette_[word & ((1u << bits_) - 1)];
+	}
+
+	void set(std::size_t i, block_id_t id);
+
+	bool uniform() const
+	{
+		return bits_ == 0;
+	}
+
+	unsigned bits() const
+	{
+		return bits_;
+	}
+
+	std::size_t palette_size() const
+	{
+		return palette_.size();
+	}
+
+	// heap bytes held
+	std::size_t bytes() const
+	{
+		return palette_.capacity() * sizeof(block_id_t)
+				+ words_.capacity() * sizeof(std::uint64_t);
+	}
+
+private:
+	static unsigned bits_for(std::size_t palette_size);
+	std::size_t palette_index(block_id_t id) const;
+	void set_index(std::size_t i, std::size_t index);
+	void repack(unsigned bits);
+
+	std::size_t count_ = 0;
+	unsigned bits_ = 0;
+	std::vector<block_id_t> palette_;
+	std::vector<std::uint64_t> words_;
+};
+
+enum class LightChannel
+{
+	SKY, BLOCK
+};
+
+// Sky and block light of a chunk's blocks, 4 bits each (0 ..
+// max_level), one byte per block in Chunk::convert_index order.
+class ChunkLight
+{
+public:
+	constexpr static std::uint8_t max_level = 15;
+
+	// count blocks, all dark.
+	explicit ChunkLight(std::size_t count) :
+			levels_(count)
+	{
+	}
+
+	std::uint8_t get(LightChannel channel, std::size_t i) const
+	{
+		return levels_[i] >> shift(channel) & max_level;
+	}
+
+	void set(LightChannel channel, std::size_t i, std::uint8_t level)
+	{
+		levels_[i] = (std::uint8_t) ((levels_[i]
+				& ~(max_level << shift(channel))) | level << shift(channel));
+	}
+
+	// the brighter of the two channels
+	std::uint8_t level(std::size_t i) const
+	{
+		return std::max(levels_[i] >> 4, levels_[i] & max_level);
+	}
+
+	std::size_t bytes() const
+	{
+		return levels_.capacity();
+	}
+
+private:
+	static int shift(LightChannel channel)
+	{
+		return channel == LightChannel::SKY ? 4 : 0;
+	}
+
+	std::vector<std::uint8_t> levels_;
+};
+
+// One bit per block of a chunk in Chunk::convert_index order, so that
+// the 16 blocks of a column are one 16-bit field.
+class ChunkMask
+{
+public:
+	// count blocks, none set.
+	explicit ChunkMask(std::size_t count) :
+			words_((count + 63) / 64)
+	{
+	}
+
+	void set(std::size_t i)
+	{
+		words_[i / 64] |= std::uint64_t(1) << i % 64;
+	}
+
+	bool get(std::size_t i) const
+	{
+		return words_[i / 64] >> i % 64 & 1;
+	}
+
+	// bits i .. i + 15; i a multiple of 16
+	unsigned column(std::size_t i) const
+	{
+		return (unsigned) (words_[i / 64] >> i % 64) & 0xffff;
+	}
+
+private:
+	std::vector<std::uint64_t> words_;
+};
+
+// Run-length encoding of block ids for serialization: pairs of
+// (run length - 1, block id), runs of at most 256 blocks.
+std::vector<std::uint8_t> rle_encode(const Block *blocks, std::size_t count);
+
+// Decodes exactly count blocks into out; false if data is malformed.
+bool rle_decode(const std::uint8_t *data, std::size_t size, Block *out,
+		std::size_t count);
+
+}
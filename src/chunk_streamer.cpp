@@ -0,0 +1,215 @@
+#include "chunk_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace mycraft;
+
+ChunkStreamer::ChunkStreamer(std::shared_ptr<World> world,
+		std::shared_ptr<const WorldGenerator> generator,
+		const StreamingConfig &config, std::shared_ptr<RegionStore> store,
+		unsigned threads) :
+		world_(std::move(world)), generator_(std::move(generator)), store_(
+				std::move(store)), config_(config)
+{
+	if (threads == 0)
+	{
+		const unsigned hw = std::thread::hardware_concurrency();
+		threads = hw > 1 ? hw - 1 : 1;
+	}
+
+	workers_.reserve(threads);
+	for (unsigned i = 0; i < threads; i++)
+		workers_.emplace_back(&ChunkStreamer::worker_main, this);
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	jobs_cv_.notify_all();
+	for (auto &worker : workers_)
+		worker.join();
+}
+
+ChunkCoord ChunkStreamer::chunk_at(double x, double y, double z)
+{
+	return ChunkCoord((CoordElem) std::floor(x / Chunk::chunk_length),
+			(CoordElem) std::floor(y / Chunk::chunk_length),
+			(CoordElem) std::floor(z / Chunk::chunk_height));
+}
+
+bool ChunkStreamer::is_loaded(const ChunkCoord &c) const
+{
+	return world_->find_chunk(c) || empty_.count(pack_chunk_coord(c));
+}
+
+bool ChunkStreamer::in_load_range(const ChunkCoord &c) const
+{
+	const int dx = c.x() - center_.x();
+	const int dy = c.y() - center_.y();
+	const int dz = c.z() - center_.z();
+	return dx * dx + dy * dy <= config_.load_radius * config_.load_radius
+			&& std::abs(dz) <= config_.vertical_radius;
+}
+
+bool ChunkStreamer::in_keep_range(const ChunkCoord &c) const
+{
+	const int dx = c.x() - center_.x();
+	const int dy = c.y() - center_.y();
+	const int dz = c.z() - center_.z();
+	return dx * dx + dy * dy <= config_.unload_radius * config_.unload_radius
+			&& std::abs(dz) <= config_.vertical_radius + 1;
+}
+
+bool ChunkStreamer::loaded_around_center(int radius) const
+{
+	for (int dx = -radius; dx <= radius; dx++)
+		for (int dy = -radius; dy <= radius; dy++)
+			for (int dz = -config_.vertical_radius;
+					dz <= config_.vertical_radius; dz++)
+			{
+				if (dx * dx + dy * dy > radius * radius)
+					continue;
+				if (!is_loaded(
+						ChunkCoord(center_.x() + dx, center_.y() + dy,
+								center_.z() + dz)))
+					return false;
+			}
+	return true;
+}
+
+void ChunkStreamer::update(double x, double y, double z,
+		std::vector<ChunkCoord> &loaded, std::vector<ChunkCoord> &unloaded)
+{
+	const ChunkCoord center = chunk_at(x, y, z);
+	if (!has_center_ || center != center_)
+	{
+		center_ = center;
+		has_center_ = true;
+		evict(unloaded);
+		rebuild_queue();
+	}
+
+	// finished chunks; the player may have moved away in the meantime
+	std::vector<std::pair<ChunkCoord, std::shared_ptr<Chunk>>> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		done.swap(done_);
+	}
+	for (auto &result : done)
+	{
+		in_flight_.erase(pack_chunk_coord(result.first));
+		if (!in_keep_range(result.first) || is_loaded(result.first))
+			continue;
+		if (result.second->empty())
+		{
+			empty_.insert(pack_chunk_coord(result.first));
+			continue;
+		}
+		world_->set_chunk(result.first, std::move(result.second));
+		loaded.push_back(result.first);
+	}
+
+	// hand the nearest wanted chunks to the workers
+	size_t submitted = 0;
+	while (in_flight_.size() < config_.max_in_flight && !queue_.empty())
+	{
+		const ChunkCoord c = queue_.back();
+		queue_.pop_back();
+		if (is_loaded(c))
+			continue;
+		in_flight_.insert(pack_chunk_coord(c));
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			jobs_.push_back(c);
+		}
+		submitted++;
+	}
+	if (submitted)
+		jobs_cv_.notify_all();
+}
+
+void ChunkStreamer::evict(std::vector<ChunkCoord> &unloaded)
+{
+	const size_t first = unloaded.size();
+	world_->for_each_chunk(
+			[&](const ChunkCoord &c, const std::shared_ptr<Chunk> &chunk)
+			{
+				if (in_keep_range(c))
+					return;
+				if (store_ && chunk->needs_save())
+					store_->save(c, *chunk);
+				unloaded.push_back(c);
+			});
+	for (size_t i = first; i < unloaded.size(); i++)
+		world_->free_chunk(unloaded[i]);
+
+	for (auto it = empty_.begin(); it != empty_.end();)
+	{
+		if (in_keep_range(unpack_chunk_coord(*it)))
+			++it;
+		else
+			it = empty_.erase(it);
+	}
+}
+
+void ChunkStreamer::rebuild_queue()
+{
+	queue_.clear();
+	const int r = config_.load_radius;
+	const int vr = config_.vertical_radius;
+	for (int dx = -r; dx <= r; dx++)
+		for (int dy = -r; dy <= r; dy++)
+			for (int dz = -vr; dz <= vr; dz++)
+			{
+				const ChunkCoord c(center_.x() + dx, center_.y() + dy,
+						center_.z() + dz);
+				if (!in_load_range(c) || is_loaded(c)
+						|| in_flight_.count(pack_chunk_coord(c)))
+					continue;
+				queue_.push_back(c);
+			}
+
+	// farthest first, so that the nearest chunk is at the back
+	auto dist2 = [this](const ChunkCoord &c)
+	{
+		const int dx = c.x() - center_.x();
+		const int dy = c.y() - center_.y();
+		const int dz = c.z() - center_.z();
+		return dx * dx + dy * dy + dz * dz;
+	};
+	std::sort(queue_.begin(), queue_.end(),
+			[&dist2](const ChunkCoord &a, const ChunkCoord &b)
+			{	return dist2(a) > dist2(b);});
+}
+
+void ChunkStreamer::worker_main()
+{
+	for (;;)
+	{
+		ChunkCoord c;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			jobs_cv_.wait(lock, [this]
+			{	return stopping_ || !jobs_.empty();});
+			if (stopping_)
+				return;
+			c = jobs_.front();
+			jobs_.pop_front();
+		}
+
+		std::shared_ptr<Chunk> chunk = store_ ? store_->load(c) : nullptr;
+		if (!chunk)
+		{
+			chunk = std::make_shared<Chunk>(
+					generator_->generate_chunk(c.x(), c.y(), c.z()));
+			chunk->compact();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		done_.emplace_back(c, std::move(chunk));
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "world.h"
+#include "worldgen.h"
+#include "region_file.h"
+
+namespace mycraft
+{
+
+// Distances are in chunks. Horizontally, chunks whose centre is within
+// load_radius of the player's chunk are loaded and kept until they are
+// farther than unload_radius; vertically the same applies to
+// vertical_radius and vertical_radius + 1.
+struct StreamingConfig
+{
+	int load_radius = 4;
+	int unload_radius = 6;
+	int vertical_radius = 1;
+	// generation jobs handed to the workers at once; the rest wait in
+	// a nearest-first queue that is rebuilt when the player moves.
+	size_t max_in_flight = 16;
+};
+
+// Keeps the chunks around the player loaded in a World: generates the
+// ones that come within range on background threads, nearest first, and
+// evicts the ones that leave the hysteresis band, so that the number of
+// loaded chunks stays bounded however far the player travels. Chunks
+// that turn out to be all air (the sky) are only remembered as empty and
+// never stored in the World, so they take no memory and are not meshed.
+// With a RegionStore, stored chunks are loaded instead of generated and
+// evicted chunks with unsaved edits are written back.
+class ChunkStreamer
+{
+public:
+	// threads == 0 picks one less than the number of hardware threads.
+	ChunkStreamer(std::shared_ptr<World> world,
+			std::shared_ptr<const WorldGenerator> generator,
+			const StreamingConfig &config = StreamingConfig(),
+			std::shared_ptr<RegionStore> store = nullptr, unsigned threads = 0);
+	ChunkStreamer(const ChunkStreamer&) = delete;
+	ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+	~ChunkStreamer();
+
+	// Called once per frame with the player position in blocks. Moves
+	// finished chunks into the World and evicts chunks out of range;
+	// their coordinates are appended to loaded and unloaded.
+	void update(double x, double y, double z, std::vector<ChunkCoord> &loaded,
+			std::vector<ChunkCoord> &unloaded);
+
+	// The chunk containing the block position (x, y, z).
+	static ChunkCoord chunk_at(double x, double y, double z);
+
+	// true if every chunk within radius (horizontally, and in the
+	// player's vertical range) of the current centre is loaded.
+	bool loaded_around_center(int radius) const;
+
+	// chunks within range that are not loaded yet.
+	size_t pending() const
+	{
+		return queue_.size() + in_flight_.size();
+	}
+
+	const StreamingConfig& config() const
+	{
+		return config_;
+	}
+
+private:
+	// stored in the World or known to be empty
+	bool is_loaded(const ChunkCoord &c) const;
+	bool in_load_range(const ChunkCoord &c) const;
+	bool in_keep_range(const ChunkCoord &c) const;
+	void evict(std::vector<ChunkCoord> &unloaded);
+	void rebuild_queue();
+	void worker_main();
+
+	std::shared_ptr<World> world_;
+	std::shared_ptr<const WorldGenerator> generator_;
+	std::shared_ptr<RegionStore> store_;
+	StreamingConfig config_;
+	ChunkCoord center_;
+	bool has_center_ = false;
+
+	// render thread only
+	std::vector<ChunkCoord> queue_; // farthest first, popped from the back
+	std::unordered_set<std::uint64_t> in_flight_; // packed coordinates
+	std::unordered_set<std::uint64_t> empty_; // packed coordinates
+
+	// shared with the workers
+	std::mutex mutex_;
+	std::condition_variable jobs_cv_;
+	std::deque<ChunkCoord> jobs_;
+	std::vector<std::pair<ChunkCoord, std::shared_ptr<Chunk>>> done_;
+	bool stopping_ = false;
+	std::vector<std::thread> workers_;
+};
+
+}
@@ -0,0 +1,174 @@
+#include "collision.h"
+
+#include <algorithm>
+
+using namespace mycraft;
+
+namespace
+{
+
+// how close a box may come to a block face and still count as touching
+// rather than overlapping it
+constexpr float touch = 1e-4f;
+
+// floor and ceil to a block coordinate (std::floor and std::ceil are
+// libm calls without SSE 4.1)
+std::int64_t floor_block(float v)
+{
+	const auto i = (std::int64_t) v;
+	return i - (v < i);
+}
+
+std::int64_t ceil_block(float v)
+{
+	const auto i = (std::int64_t) v;
+	return i + (v > i);
+}
+
+// blocks of a chunk are 16 per side: world coordinate >> 4 is the chunk,
+// & 15 the position in it
+constexpr int chunk_shift = 4;
+static_assert(Chunk::chunk_length == 1 << chunk_shift
+		&& Chunk::chunk_height == 1 << chunk_shift,
+		"chunks must be 16 blocks per side");
+
+}
+
+std::unique_ptr<ChunkMask> mycraft::solid_mask(const Chunk &chunk,
+		const BlockRegistry &registry)
+{
+	auto mask = std::make_unique<ChunkMask>(Chunk::block_count);
+	const auto blocks = chunk.expanded();
+	for (size_t i = 0; i < blocks.size(); i++)
+		if (registry[blocks[i].block_id()].solid())
+			mask->set(i);
+	return mask;
+}
+
+CollisionWorld::CollisionWorld(const World &world,
+		std::shared_ptr<const BlockRegistry> registry) :
+		world_(world), registry_(std::move(registry))
+{
+}
+
+const ChunkMask* CollisionWorld::solids(const ChunkCoord &c)
+{
+	const auto key = pack_chunk_coord(c);
+	if (last_valid_ && key == last_key_)
+		return last_;
+	const Chunk *chunk = world_.find_chunk(c);
+	if (chunk && !chunk->solids())
+	{
+		chunk->set_solids(solid_mask(*chunk, *registry_));
+		masks_built_++;
+	}
+	last_key_ = key;
+	last_ = chunk ? chunk->solids() : nullptr;
+	last_valid_ = true;
+	return last_;
+}
+
+std::uint64_t CollisionWorld::solid_layers(const std::int64_t (&min)[3],
+		const std::int64_t (&max)[3], int axis)
+{
+	std::uint64_t layers = 0;
+	for (auto cx = min[0] >> chunk_shift; cx <= max[0] >> chunk_shift; cx++)
+		for (auto cy = min[1] >> chunk_shift; cy <= max[1] >> chunk_shift; cy++)
+			for (auto cz = min[2] >> chunk_shift; cz <= max[2] >> chunk_shift;
+					cz++)
+			{
+				const ChunkMask *chunk = solids(
+						ChunkCoord((CoordElem) cx, (CoordElem) cy,
+								(CoordElem) cz));
+				if (!chunk)
+					continue;
+				// the part of the box in this chunk, in world coordinates
+				const auto x0 = std::max(min[0], cx << chunk_shift);
+				const auto x1 = std::min(max[0], (cx << chunk_shift) + 15);
+				const auto y0 = std::max(min[1], cy << chunk_shift);
+				const auto y1 = std::min(max[1], (cy << chunk_shift) + 15);
+				const auto z0 = std::max(min[2], cz << chunk_shift);
+				const auto z1 = std::min(max[2], (cz << chunk_shift) + 15);
+				const unsigned z_mask = (2u << (z1 & 15)) - (1u << (z0 & 15));
+				for (auto x = x0; x <= x1; x++)
+					for (auto y = y0; y <= y1; y++)
+					{
+						const unsigned column = chunk->column(
+								Chunk::convert_index(x & 15, y & 15, 0))
+								& z_mask;
+						if (!column)
+							continue;
+						if (axis == 2)
+							layers |= (std::uint64_t) (column >> (z0 & 15))
+									<< (z0 - min[2]);
+						else
+							layers |= std::uint64_t(1)
+									<< ((axis == 0 ? x : y) - min[axis]);
+					}
+			}
+	return layers;
+}
+
+float CollisionWorld::sweep(const Aabb &box, int axis, float distance)
+{
+	if (distance == 0)
+		return 0;
+
+	// the blocks the box overlaps across the axis
+	std::int64_t min[3], max[3];
+	for (int a = 0; a < 3; a++)
+	{
+		min[a] = floor_block(box.min[a] + touch);
+		max[a] = ceil_block(box.max[a] - touch) - 1;
+	}
+
+	// the layers of blocks the move passes into, nearest first, read a few
+	// at a time at first (the way is mostly blocked near the box, if at
+	// all) and then up to 64 at a time
+	std::int64_t window = 4;
+	if (distance > 0)
+	{
+		const auto first = ceil_block(box.max[axis] - touch);
+		const auto last = ceil_block(box.max[axis] + distance) - 1;
+		for (auto lo = first; lo <= last; lo += window, window = 64)
+		{
+			min[axis] = lo;
+			max[axis] = std::min(lo + window - 1, last);
+			if (const auto layers = solid_layers(min, max, axis))
+				return std::max(0.0f,
+						lo + __builtin_ctzll(layers) - box.max[axis]);
+		}
+	}
+	else
+	{
+		const auto first = floor_block(box.min[axis] + touch) - 1;
+		const auto last = floor_block(box.min[axis] + distance);
+		for (auto hi = first; hi >= last; hi -= window, window = 64)
+		{
+			min[axis] = std::max(hi - window + 1, last);
+			max[axis] = hi;
+			if (const auto layers = solid_layers(min, max, axis))
+				return std::min(0.0f,
+						min[axis] + 64 - __builtin_clzll(layers)
+								- box.min[axis]);
+		}
+	}
+	return distance;
+}
+
+SweepResult CollisionWorld::move(Aabb &box, const float (&motion)[3])
+{
+	// chunks may have changed or gone since the last move
+	last_valid_ = false;
+	SweepResult result;
+	for (const int axis :
+	{ 2, 0, 1 })
+	{
+		const float moved = sweep(box, axis, motion[axis]);
+		box.min[axis] += moved;
+		box.max[axis] += moved;
+		result.moved[axis] = moved;
+		result.blocked[axis] = moved != motion[axis];
+	}
+	return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "block_registry.h"
+#include "culling.h"
+#include "world.h"
+
+namespace mycraft
+{
+
+// Which blocks of chunk are solid (BlockInfo::solid()).
+std::unique_ptr<ChunkMask> solid_mask(const Chunk &chunk,
+		const BlockRegistry &registry);
+
+// What CollisionWorld::move() did: the distance moved on each axis and
+// whether a block stopped it there.
+struct SweepResult
+{
+	float moved[3];
+	bool blocked[3];
+};
+
+// Moves axis-aligned boxes through the solid blocks of a World.
+// Solidity is read in bulk: the first time a box comes near a chunk, its
+// solid_mask() is built and kept in the chunk (Chunk::solids()) until its
+// blocks change, and a sweep reads the mask a 16-block column at a time.
+// Chunks that are not stored are empty.
+class CollisionWorld
+{
+public:
+	CollisionWorld(const World &world,
+			std::shared_ptr<const BlockRegistry> registry);
+
+	// Moves box by motion one axis at a time (z, then x, then y). Each
+	// move stops at the face of the first solid block in its way, however
+	// far it is. Blocks the box already overlaps don't stop it, so a box
+	// stuck in the terrain can move out.
+	SweepResult move(Aabb &box, const float (&motion)[3]);
+
+	// solid_mask() builds so far
+	std::uint64_t masks_built() const
+	{
+		return masks_built_;
+	}
+
+private:
+	// nullptr if the chunk is not stored
+	const ChunkMask* solids(const ChunkCoord &c);
+	// Bit i set if a block of layer min[axis] + i of the box [min, max]
+	// (inclusive, at most 64 layers along axis) is solid.
+	std::uint64_t solid_layers(const std::int64_t (&min)[3],
+			const std::int64_t (&max)[3], int axis);
+	float sweep(const Aabb &box, int axis, float distance);
+
+	const World &world_;
+	std::shared_ptr<const BlockRegistry> registry_;
+	// the chunk of the previous solids() in this move(); a move mostly
+	// stays in one
+	std::uint64_t last_key_ = 0;
+	const ChunkMask *last_ = nullptr;
+	bool last_valid_ = false;
+	std::uint64_t masks_built_ = 0;
+};
+
+}
@@ -0,0 +1,82 @@
+#include "culling.h"
+
+using namespace mycraft;
+
+Aabb mycraft::chunk_bounds(const ChunkCoord &coord)
+{
+	constexpr float cl = Chunk::chunk_length;
+	constexpr float ch = Chunk::chunk_height;
+	return Aabb
+	{
+	{ coord.x() * cl, coord.y() * cl, coord.z() * ch },
+	{ (coord.x() + 1) * cl, (coord.y() + 1) * cl, (coord.z() + 1) * ch } };
+}
+
+Frustum::Frustum(const float *m)
+{
+	// Gribb/Hartmann: the planes are sums and differences of the fourth
+	// row with the other three. row(i) = (m[i], m[4 + i], m[8 + i], m[12 + i])
+	auto row = [m](int i, int j)
+	{	return m[j * 4 + i];};
+	for (int p = 0; p < 6; p++)
+	{
+		const int axis = p / 2;
+		const float sign = p % 2 == 0 ? 1.0f : -1.0f;
+		planes_[p] =
+		{ row(3, 0) + sign * row(axis, 0), row(3, 1) + sign * row(axis, 1),
+				row(3, 2) + sign * row(axis, 2), row(3, 3)
+						+ sign * row(axis, 3) };
+	}
+}
+
+bool Frustum::intersects(const Aabb &box) const
+{
+	for (const auto &p : planes_)
+	{
+		// the corner farthest along the plane normal
+		const float x = p.a >= 0 ? box.max[0] : box.min[0];
+		const float y = p.b >= 0 ? box.max[1] : box.min[1];
+		const float z = p.c >= 0 ? box.max[2] : box.min[2];
+		if (p.a * x + p.b * y + p.c * z + p.d < 0)
+			return false;
+	}
+	return true;
+}
+
+ChunkCuller::ChunkCuller(const float *view_proj, const float (&eye)[3],
+		float view_distance) :
+		frustum_(view_proj), eye_
+		{ eye[0], eye[1], eye[2] }, view_distance_sq_(
+				view_distance * view_distance)
+{
+}
+
+CullResult ChunkCuller::test(const ChunkCoord &coord)
+{
+	stats_.tested++;
+	const Aabb box = chunk_bounds(coord);
+
+	// distance from the eye to the nearest point of the box
+	float d2 = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const float d =
+				eye_[i] < box.min[i] ? box.min[i] - eye_[i] :
+				eye_[i] > box.max[i] ? eye_[i] - box.max[i] : 0;
+		d2 += d * d;
+	}
+	if (d2 > view_distance_sq_)
+	{
+		stats_.culled_distance++;
+		return CullResult::BEYOND_VIEW_DISTANCE;
+	}
+
+	if (!frustum_.intersects(box))
+	{
+		stats_.culled_frustum++;
+		return CullResult::OUTSIDE_FRUSTUM;
+	}
+
+	stats_.drawn++;
+	return CullResult::VISIBLE;
+}
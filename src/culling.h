@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include "world.h"
+
+namespace mycraft
+{
+
+// Axis-aligned box in world (block) coordinates.
+struct Aabb
+{
+	float min[3];
+	float max[3];
+};
+
+// The box covered by the chunk at coord.
+Aabb chunk_bounds(const ChunkCoord &coord);
+
+// The six clip planes of a view-projection matrix. Independent of any GL
+// context: the matrix is read as 16 floats in column-major order (as
+// given by glm::value_ptr).
+class Frustum
+{
+public:
+	explicit Frustum(const float *view_proj);
+
+	// false only if box lies entirely outside one of the planes.
+	bool intersects(const Aabb &box) const;
+
+private:
+	// a x + b y + c z + d >= 0 inside
+	struct Plane
+	{
+		float a, b, c, d;
+	};
+	Plane planes_[6];
+};
+
+enum class CullResult
+{
+	VISIBLE, BEYOND_VIEW_DISTANCE, OUTSIDE_FRUSTUM
+};
+
+struct CullStats
+{
+	std::size_t tested = 0;
+	std::size_t culled_distance = 0;
+	std::size_t culled_frustum = 0;
+	std::size_t drawn = 0;
+};
+
+// Decides which chunks to draw for one frame and counts the decisions.
+class ChunkCuller
+{
+public:
+	// eye is the camera position; chunks whose box is farther than
+	// view_distance blocks from it are culled before the frustum test.
+	ChunkCuller(const float *view_proj, const float (&eye)[3],
+			float view_distance);
+
+	CullResult test(const ChunkCoord &coord);
+
+	const CullStats& stats() const
+	{
+		return stats_;
+	}
+
+private:
+	Frustum frustum_;
+	float eye_[3];
+	float view_distance_sq_;
+	CullStats stats_;
+};
+
+}
@@ -0,0 +1,150 @@
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr const char *stage_names[] =
+{ "input", "streaming", "meshing", "upload", "draw", "swap", "frame" };
+
+constexpr size_t stage_count = static_cast<size_t>(FrameStage::COUNT);
+
+}
+
+const char* mycraft::stage_name(FrameStage stage)
+{
+	return stage_names[static_cast<size_t>(stage)];
+}
+
+void StageTimings::add(std::chrono::nanoseconds elapsed)
+{
+	const auto ns = (std::uint64_t) std::max<std::int64_t>(0, elapsed.count());
+	history_ns_[next_] = (std::uint32_t) std::min<std::uint64_t>(ns,
+			std::numeric_limits<std::uint32_t>::max());
+	next_ = (next_ + 1) % history_length;
+	count_++;
+	total_ns_ += ns;
+
+	// bucket b > 0 holds [2^(b-1), 2^b) microseconds
+	size_t b = 0;
+	for (auto us = ns / 1000; us && b < bucket_count - 1; us >>= 1)
+		b++;
+	histogram_[b]++;
+}
+
+StageTimings::Summary StageTimings::summary() const
+{
+	Summary s
+	{ count_, 0, 0, 0, 0, 0 };
+	if (count_ == 0)
+		return s;
+	s.mean_us = total_ns_ / 1e3 / count_;
+
+	std::vector<std::uint32_t> recent(history_ns_.begin(),
+			history_ns_.begin() + std::min<std::uint64_t>(count_,
+					history_length));
+	std::sort(recent.begin(), recent.end());
+	auto percentile = [&recent](double p)
+	{
+		return recent[(size_t) (p * (recent.size() - 1) + 0.5)] / 1e3;
+	};
+	s.p50_us = percentile(0.50);
+	s.p95_us = percentile(0.95);
+	s.p99_us = percentile(0.99);
+	s.max_us = recent.back() / 1e3;
+	return s;
+}
+
+void FrameProfiler::reset()
+{
+	stages_ = decltype(stages_)();
+}
+
+void FrameProfiler::write_csv(std::ostream &os) const
+{
+	os << "stage,count,mean_us,p50_us,p95_us,p99_us,max_us";
+	for (size_t b = 0; b < StageTimings::bucket_count; b++)
+		os << ",ge_" << StageTimings::bucket_floor_us(b) << "us";
+	os << '\n';
+
+	for (size_t i = 0; i < stage_count; i++)
+	{
+		const auto s = stages_[i].summary();
+		char row[160];
+		std::snprintf(row, sizeof(row), "%s,%llu,%.2f,%.2f,%.2f,%.2f,%.2f",
+				stage_names[i], (unsigned long long) s.count, s.mean_us,
+				s.p50_us, s.p95_us, s.p99_us, s.max_us);
+		os << row;
+		for (const auto n : stages_[i].histogram())
+			os << ',' << n;
+		os << '\n';
+	}
+}
+
+void FrameProfiler::write_json(std::ostream &os) const
+{
+	os << "{\n  \"stages\": [\n";
+	for (size_t i = 0; i < stage_count; i++)
+	{
+		const auto s = stages_[i].summary();
+		char head[256];
+		std::snprintf(head, sizeof(head),
+				"    {\"stage\": \"%s\", \"count\": %llu, \"mean_us\": %.2f, "
+						"\"p50_us\": %.2f, \"p95_us\": %.2f, \"p99_us\": %.2f, "
+						"\"max_us\": %.2f,\n     \"histogram\": [",
+				stage_names[i], (unsigned long long) s.count, s.mean_us,
+				s.p50_us, s.p95_us, s.p99_us, s.max_us);
+		os << head;
+
+		// only the buckets that were hit
+		bool first = true;
+		const auto &histogram = stages_[i].histogram();
+		for (size_t b = 0; b < histogram.size(); b++)
+		{
+			if (!histogram[b])
+				continue;
+			os << (first ? "" : ", ") << "{\"ge_us\": "
+					<< StageTimings::bucket_floor_us(b) << ", \"count\": "
+					<< histogram[b] << '}';
+			first = false;
+		}
+		os << "]}" << (i + 1 < stage_count ? "," : "") << '\n';
+	}
+	os << "  ]\n}\n";
+}
+
+void FrameProfiler::write_file(const std::string &path) const
+{
+	std::ofstream out(path);
+	const auto json = path.size() >= 5
+			&& path.compare(path.size() - 5, 5, ".json") == 0;
+	if (json)
+		write_json(out);
+	else
+		write_csv(out);
+	out.flush();
+	if (!out)
+		throw std::runtime_error("cannot write frame timings to " + path);
+}
+
+std::string FrameProfiler::overlay_text() const
+{
+	std::string text;
+	char part[64];
+	for (size_t i = 0; i < stage_count; i++)
+	{
+		const auto s = stages_[i].summary();
+		std::snprintf(part, sizeof(part), "%s%s %.2f/%.2f", i ? " | " : "",
+				stage_names[i], s.p50_us / 1e3, s.p95_us / 1e3);
+		text += part;
+	}
+	return text + " ms (p50/p95)";
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace mycraft
+{
+
+// The parts of a frame that are timed, in the order they appear in the
+// dumps. FRAME is the whole iteration of the render loop.
+enum class FrameStage
+{
+	INPUT, STREAMING, MESHING, UPLOAD, DRAW, SWAP, FRAME, COUNT
+};
+
+const char* stage_name(FrameStage stage);
+
+// Timings of one stage: the last history_length samples in a ring buffer,
+// for recent percentiles, and a histogram of every sample since the last
+// reset in power-of-two microsecond buckets ([0, 1), [1, 2), [2, 4), ...;
+// the last bucket is open-ended).
+class StageTimings
+{
+public:
+	constexpr static size_t history_length = 256;
+	constexpr static size_t bucket_count = 24;
+
+	struct Summary
+	{
+		std::uint64_t count;
+		double mean_us;
+		// over the samples still in the ring buffer
+		double p50_us, p95_us, p99_us, max_us;
+	};
+
+	void add(std::chrono::nanoseconds elapsed);
+	Summary summary() const;
+
+	std::uint64_t count() const
+	{
+		return count_;
+	}
+
+	const std::array<std::uint64_t, bucket_count>& histogram() const
+	{
+		return histogram_;
+	}
+
+	// lower bound of bucket b, in microseconds
+	static std::uint64_t bucket_floor_us(size_t b)
+	{
+		return b == 0 ? 0 : std::uint64_t(1) << (b - 1);
+	}
+
+private:
+	std::array<std::uint32_t, history_length> history_ns_
+	{ };
+	size_t next_ = 0;
+	std::uint64_t count_ = 0;
+	std::uint64_t total_ns_ = 0;
+	std::array<std::uint64_t, bucket_count> histogram_
+	{ };
+};
+
+// Per-stage frame timings. Disabled by default: while disabled a
+// ScopedTimer costs one branch and reads no clock. Not thread-safe; time
+// the render thread only.
+class FrameProfiler
+{
+public:
+	bool enabled() const
+	{
+		return enabled_;
+	}
+
+	void set_enabled(bool enabled)
+	{
+		enabled_ = enabled;
+	}
+
+	void record(FrameStage stage, std::chrono::nanoseconds elapsed)
+	{
+		stages_[static_cast<size_t>(stage)].add(elapsed);
+	}
+
+	const StageTimings& stage(FrameStage stage) const
+	{
+		return stages_[static_cast<size_t>(stage)];
+	}
+
+	void reset();
+
+	// one row per stage: the summary, then the histogram buckets
+	void write_csv(std::ostream &os) const;
+	void write_json(std::ostream &os) const;
+	// JSON if path ends in ".json", CSV otherwise. Throws
+	// std::runtime_error if the file cannot be written.
+	void write_file(const std::string &path) const;
+
+	// A single line of recent p50 / p95 per stage, for the overlay.
+	std::string overlay_text() const;
+
+private:
+	bool enabled_ = false;
+	std::array<StageTimings, static_cast<size_t>(FrameStage::COUNT)> stages_;
+};
+
+// Records the time until the end of the enclosing scope under stage.
+class ScopedTimer
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	ScopedTimer(FrameProfiler &profiler, FrameStage stage) :
+			profiler_(profiler.enabled() ? &profiler : nullptr), stage_(stage)
+	{
+		if (profiler_)
+			start_ = clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if (profiler_)
+			profiler_->record(stage_, clock::now() - start_);
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	FrameProfiler *profiler_;
+	FrameStage stage_;
+	clock::time_point start_;
+};
+
+}
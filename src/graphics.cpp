@@ -4,6 +4,8 @@
 #include <GLFW/glfw3.h>
 #include <cassert>
 #include <SOIL/SOIL.h>
+#include "raycast.h"
+#include "texture_cache.h"
 
 using namespace mycraft;
 
@@ -33,7 +35,8 @@ private:
 
 Renderer::Renderer(int window_width, int window_height,
 		const std::string &window_title) :
-		keyboard_handler_data_(new KeyboardHandlerData)
+		window_title_(window_title), keyboard_handler_data_(
+				new KeyboardHandlerData)
 {
 	global_renderer = this;
 
@@ -63,8 +66,6 @@ Renderer::Renderer(int window_width, int window_height,
 		glfwSetInputMode(window_, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
 	glfwSetCursorPosCallback(window_, &mousemotion_handler);
 	glfwGetCursorPos(window_, &last_cursor_xpos, &last_cursor_ypos);
-
-	chunks_.reserve(9);
 }
 
 struct ShaderCompileError: std::runtime_error
@@ -105,21 +106,47 @@ void Renderer::prepare_shaders()
 			R"glsl(
 #version 150 core
 
-in vec3 block;
-in vec2 texCoord;
+// packed as described at MeshVertex
+in uint vertex;
 
 out vec3 Block;
+flat out float Light;
 out vec2 TexCoord;
+flat out vec2 Tile;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 proj;
 
+// multi-draw: the vertices live in pages of the shared vertex buffer and
+// the chunk's block offset is looked up per page instead of in model
+uniform bool paged;
+uniform samplerBuffer page_offsets;
+const int page_vertices = )glsl" + std::to_string(mesh_page_vertices)
+					+ R"glsl(;
+
+// per face direction (TexDir order): the axes texture u and v run
+// along, and the direction of u
+const int u_axis[6] = int[6](1, 0, 1, 0, 0, 0);
+const float u_sign[6] = float[6](-1.0, 1.0, 1.0, -1.0, 1.0, 1.0);
+const int v_axis[6] = int[6](2, 2, 2, 2, 1, 1);
+
 void main()
 {
-	gl_Position = proj * view * model * vec4(block, 1.0);
+	vec3 block = vec3(float(vertex & 31u), float((vertex >> 5) & 31u),
+			float((vertex >> 10) & 31u));
+	int face = int((vertex >> 15) & 7u);
+
+	vec3 pos = block;
+	if (paged)
+		pos += texelFetch(page_offsets, gl_VertexID / page_vertices).xyz;
+	gl_Position = proj * view * model * vec4(pos, 1.0);
 	Block = block;
-	TexCoord = texCoord;
+	// differs from the offset within the quad by whole tiles only
+	TexCoord = vec2(u_sign[face] * block[u_axis[face]], block[v_axis[face]]);
+	Tile = vec2(float((vertex >> 18) & 15u), float((vertex >> 22) & 15u));
+	// each level 80% of the one above, never quite black
+	Light = 0.1 + 0.9 * pow(0.8, 15.0 - float((vertex >> 26) & 15u));
 }
 )glsl";
 
@@ -129,6 +156,8 @@ void main()
 
 in vec3 Block;
 in vec2 TexCoord;
+flat in vec2 Tile;
+flat in float Light;
 
 uniform sampler2D tex0;
 
@@ -136,7 +165,12 @@ out vec4 outColor;
 
 void main()
 {
-	outColor = texture(tex0, vec2(TexCoord.x / 16.0, 1.0-TexCoord.y/16.0));
+	// repeat the tile across quads merged by the greedy mesher
+	vec2 tc = Tile + fract(TexCoord);
+	// mip level from the unwrapped coordinate: fract() jumps at the seams
+	outColor = textureGrad(tex0, vec2(tc.x / 16.0, 1.0-tc.y/16.0),
+			dFdx(TexCoord) / 16.0, dFdy(TexCoord) / 16.0);
+	outColor.rgb *= Light;
 	//outColor = texture(tex0, vec2(1.5, 0.5));
 	//outColor = vec4(1.0-TexCoord.x/8.0, 1.0, 1.0, 1.0);
 }
@@ -157,27 +191,18 @@ void main()
 
 void Renderer::Renderer::render_loop()
 {
-	// vertex buffer
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-	// vertex array
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	// vertex attribs
-	GLint pos_attrib = glGetAttribLocation(shader_program_, "block");
-	assert(pos_attrib >= 0);
-	glEnableVertexAttribArray(pos_attrib);
-	glVertexAttribPointer(pos_attrib, 3, GL_BYTE, GL_FALSE, 5 * sizeof(GLbyte),
-			0);
-
-	GLint texcoord_attrib = glGetAttribLocation(shader_program_, "texCoord");
-	assert(texcoord_attrib >= 0);
-	glEnableVertexAttribArray(texcoord_attrib);
-	glVertexAttribPointer(texcoord_attrib, 2, GL_BYTE, GL_FALSE,
-			5 * sizeof(GLbyte), (void*) (3 * sizeof(GLbyte)));
+	const auto startup = std::chrono::steady_clock::now();
+
+	// vertex attribs (enabled per chunk VAO in load_chunk_vertices)
+	vertex_attrib_ = glGetAttribLocation(shader_program_, "vertex");
+	assert(vertex_attrib_ >= 0);
+
+	// the index pattern every chunk mesh is drawn with
+	const auto indices = quad_indices();
+	glGenBuffers(1, &index_buffer_);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+	glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(MeshIndex),
+			indices.data(), GL_STATIC_DRAW);
 
 	// setup uniforms
 	model_uni_ = glGetUniformLocation(shader_program_, "model");
@@ -188,11 +213,19 @@ void Renderer::Renderer::render_loop()
 	assert(view_uni_ >= 0);
 	assert(proj_uni_ >= 0);
 
+	paged_uni_ = glGetUniformLocation(shader_program_, "paged");
+	assert(paged_uni_ >= 0);
+	glUniform1i(paged_uni_, GL_FALSE);
+	GLint page_offsets_uni = glGetUniformLocation(shader_program_,
+			"page_offsets");
+	assert(page_offsets_uni >= 0);
+	glUniform1i(page_offsets_uni, 1); // texture unit 1
+
 	// proj
 	// TODO: window width, clipping distance
-	glm::mat4 proj_mat = glm::perspective(glm::radians(50.0), 800.0 / 600.0,
+	proj_mat_ = glm::perspective(glm::radians(50.0), 800.0 / 600.0,
 			1.0, 50.0);
-	glUniformMatrix4fv(proj_uni_, 1, GL_FALSE, glm::value_ptr(proj_mat));
+	glUniformMatrix4fv(proj_uni_, 1, GL_FALSE, glm::value_ptr(proj_mat_));
 
 	// view initial position
 	// TODO: set meaningful initial position
@@ -204,39 +237,118 @@ void Renderer::Renderer::render_loop()
 	// load textures
 	load_textures();
 
-	// TODO: load chunks in event loop
-	for (int i = -1; i <= 1; i++)
-		for (int j = -1; j <= 1; j++)
-			for (int k = -1; k <= 1; k++)
-			{
-				const auto &chunk = world_->chunk(
-				{ i, j, k });
-				if (!chunk.has_value())
-					continue;
-				chunks_.push_back(ChunkCache<5>(
-				{ i, j, k }, std::move(chunk.value()), ts_));
-			}
+	// background meshing
+	mesh_workers_ = std::make_unique<MeshWorkerPool>(registry_);
+	light_ = std::make_unique<LightEngine>(*world_,
+			LightProperties(*registry_));
+	collision_ = std::make_unique<CollisionWorld>(*world_, registry_);
+
+	if (generator_)
+		streamer_ = std::make_unique<ChunkStreamer>(world_, generator_,
+				streaming_config_, store_);
+	else
+		for (int i = -1; i <= 1; i++)
+			for (int j = -1; j <= 1; j++)
+				for (int k = -1; k <= 1; k++)
+					load_chunk(
+					{ i, j, k });
 
+	bool first_frame = true;
 	last_update_time = std::chrono::high_resolution_clock::now();
 	while (!glfwWindowShouldClose(window_))
 	{
-		glfwSwapBuffers(window_);
-		glfwPollEvents();
+		ScopedTimer frame_timer(profiler_, FrameStage::FRAME);
+		{
+			ScopedTimer timer(profiler_, FrameStage::SWAP);
+			glfwSwapBuffers(window_);
+		}
+		{
+			ScopedTimer timer(profiler_, FrameStage::INPUT);
+			glfwPollEvents();
 
-		// player input
-		keyboard_handler_tick();
+			// player input
+			keyboard_handler_tick();
+		}
 
 		// draw
 		glClearColor(0, 0, 0, 1);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		render_world();
+		uploaded_bytes_frame_ = 0;
+		{
+			ScopedTimer timer(profiler_, FrameStage::STREAMING);
+			stream_chunks();
+		}
+		{
+			ScopedTimer timer(profiler_, FrameStage::MESHING);
+			schedule_chunk_meshes();
+		}
+		{
+			ScopedTimer timer(profiler_, FrameStage::UPLOAD);
+			install_finished_meshes();
+		}
+		{
+			ScopedTimer timer(profiler_, FrameStage::DRAW);
+			render_world();
+		}
+		update_overlay();
+		uploaded_bytes_last_frame_ = uploaded_bytes_frame_;
+		if (first_frame)
+		{
+			first_frame = false;
+			std::cout << "first frame after "
+					<< std::chrono::duration<double, std::milli>(
+							std::chrono::steady_clock::now() - startup).count()
+					<< " ms" << std::endl;
+		}
 
 		last_update_time = std::chrono::high_resolution_clock::now();
 	}
+
+	if (store_)
+	{
+		const size_t saved = store_->save_changed(*world_);
+		store_->sync();
+		std::cout << "saved " << saved << " chunks to " << store_->directory()
+				<< std::endl;
+	}
+
+	if (!profile_output_.empty())
+	{
+		try
+		{
+			profiler_.write_file(profile_output_);
+			std::cout << "wrote frame timings to " << profile_output_
+					<< std::endl;
+		} catch (const std::runtime_error &e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	print_mesh_memory(std::cout);
+	const auto &cull = cull_stats_last_frame_;
+	std::cout << "culling (last frame): " << cull.tested << " tested, "
+			<< cull.culled_distance << " beyond view distance, "
+			<< cull.culled_frustum << " outside frustum, " << cull.drawn
+			<< " drawn" << std::endl;
+	const auto &draws = draw_stats_last_frame_;
+	std::cout << "draws (last frame, " << (multi_draw_ ? "multi-draw" :
+			"per chunk") << "): " << draws.chunks_drawn << " chunks, "
+			<< draws.draw_calls << " draw calls, " << draws.state_changes
+			<< " state changes; shared vertex buffer "
+			<< arena_.pages_in_use() << "/" << arena_.capacity() << " pages"
+			<< std::endl;
 }
 
 Renderer::~Renderer()
 {
+	for (auto &chunk : chunks_)
+		release_chunk_buffers(chunk);
+	glDeleteTextures(1, &page_offset_texture_);
+	glDeleteBuffers(1, &page_offset_buffer_);
+	glDeleteBuffers(1, &arena_vbo_);
+	glDeleteBuffers(1, &index_buffer_);
+	glDeleteVertexArrays(1, &arena_vao_);
 	glfwTerminate();
 }
 
@@ -245,19 +357,96 @@ void Renderer::render_world()
 	if (!world_ || !ts_)
 		return;
 
+	// state changes go through these, which count them and skip the ones
+	// that would not change anything this frame
+	DrawStats stats;
+	bool tests_enabled = false;
+	GLuint bound_vao = 0;
+	auto enable_tests = [&]()
+	{
+		if (tests_enabled)
+			return;
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		stats.state_changes += 2;
+		tests_enabled = true;
+	};
+	auto bind_vertex_array = [&](GLuint vao)
+	{
+		if (vao == bound_vao)
+			return;
+		glBindVertexArray(vao);
+		stats.state_changes++;
+		bound_vao = vao;
+	};
+	auto set_matrix = [&](GLint uniform, const glm::mat4 &m)
+	{
+		glUniformMatrix4fv(uniform, 1, GL_FALSE, glm::value_ptr(m));
+		stats.state_changes++;
+	};
+	auto set_paged = [&](bool paged)
+	{
+		glUniform1i(paged_uni_, paged ? GL_TRUE : GL_FALSE);
+		stats.state_changes++;
+	};
+
 	// view
 	glm::mat4 view_pos_mat = glm::lookAt(view_pos_,
 			view_pos_ + view_look_at_vec_, glm::vec3(0, 0, 1));
-	glUniformMatrix4fv(view_uni_, 1, GL_FALSE, glm::value_ptr(view_pos_mat));
+	set_matrix(view_uni_, view_pos_mat);
 
-	// draw loaded chunks
-	for (const auto &chunk : chunks_)
+	const glm::mat4 view_proj = proj_mat_ * view_pos_mat;
+	const float eye[3] =
+	{ view_pos_.x, view_pos_.y, view_pos_.z };
+	ChunkCuller culler(glm::value_ptr(view_proj), eye, view_distance_);
+
+	if (multi_draw_)
+	{
+		// every visible chunk's pages in one submission
+		draw_base_vertices_.clear();
+		draw_counts_.clear();
+		for (auto &chunk : chunks_)
+		{
+			if (culler.test(chunk.chunk_coord()) != CullResult::VISIBLE)
+				continue;
+			const size_t elements = upload_chunk_pages(chunk);
+			if (elements == 0)
+				continue;
+			draw_base_vertices_.push_back(
+					chunk.gpu_buffers().first_page * mesh_page_vertices);
+			draw_counts_.push_back(
+					elements / quad_vertices * quad_indices_per_quad);
+		}
+		// every draw starts at the beginning of the shared index buffer
+		draw_index_offsets_.resize(draw_counts_.size(), nullptr);
+
+		if (!draw_counts_.empty())
+		{
+			enable_tests();
+			set_matrix(model_uni_, glm::mat4(1.0f));
+			set_paged(true);
+			bind_vertex_array(arena_vao_);
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, draw_counts_.data(),
+					GL_UNSIGNED_SHORT, draw_index_offsets_.data(),
+					draw_counts_.size(), draw_base_vertices_.data());
+			set_paged(false);
+			stats.draw_calls++;
+		}
+		stats.chunks_drawn = draw_counts_.size();
+		cull_stats_last_frame_ = culler.stats();
+		draw_stats_last_frame_ = stats;
+		return;
+	}
+
+	// draw loaded chunks that can be seen
+	for (auto &chunk : chunks_)
 	{
 		const auto &coord = chunk.chunk_coord();
+		if (culler.test(coord) != CullResult::VISIBLE)
+			continue;
 		size_t elements = load_chunk_vertices(chunk);
 
-		glEnable(GL_CULL_FACE);
-		glEnable(GL_DEPTH_TEST);
+		enable_tests();
 
 		// model
 		glm::mat4 model(1.0f);
@@ -265,55 +454,405 @@ void Renderer::render_world()
 		constexpr auto ch = Chunk::chunk_height;
 		model = glm::translate(model,
 				glm::vec3(cl * coord.x(), cl * coord.y(), ch * coord.z()));
-		glUniformMatrix4fv(model_uni_, 1, GL_FALSE, glm::value_ptr(model));
-
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		//glDrawArrays(GL_LINES, 0, elements);
-		glDrawArrays(GL_TRIANGLES, 0, elements);
+		set_matrix(model_uni_, model);
+
+		bind_vertex_array(chunk.gpu_buffers().vao);
+		glDrawElements(GL_TRIANGLES,
+				elements / quad_vertices * quad_indices_per_quad,
+				GL_UNSIGNED_SHORT, nullptr);
+		stats.draw_calls++;
+		stats.chunks_drawn++;
 	}
+	cull_stats_last_frame_ = culler.stats();
+	draw_stats_last_frame_ = stats;
 }
 
 void Renderer::load_textures()
 {
+	const std::string source = "resources/texture.png";
+	const std::string baked = "resources/texture.baked";
+	const auto start = std::chrono::steady_clock::now();
+
+	// the baked atlas if it is of the current png (or there is no png),
+	// otherwise decode the png and bake it for the next launch
+	const auto stamp = source_stamp(source);
+	std::unique_ptr<BakedTexture> cached = BakedTexture::open(baked, stamp);
+	std::unique_ptr<MipChain> decoded;
+	if (!cached)
+	{
+		int width, height;
+		unsigned char *image = SOIL_load_image(source.c_str(), &width,
+				&height, 0, SOIL_LOAD_RGB);
+		if (!image)
+			throw std::runtime_error(source + ": " + SOIL_last_result());
+		decoded = std::make_unique<MipChain>(image, width, height);
+		SOIL_free_image_data(image);
+		if (stamp)
+			try
+			{
+				bake_texture(baked, *stamp, *decoded);
+			} catch (const TextureCacheError &e)
+			{
+				std::cerr << "not caching the texture: " << e.what()
+						<< std::endl;
+			}
+	}
+	const auto &levels = cached ? cached->levels() : decoded->levels();
+
 	GLuint texture;
 	glGenTextures(1, &texture);
-
-	int width, height;
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, texture);
-	unsigned char *image = SOIL_load_image("resources/texture.png", &width,
-			&height, 0, SOIL_LOAD_RGB);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-	GL_UNSIGNED_BYTE, image);
-	SOIL_free_image_data(image);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t level = 0; level < levels.size(); level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, levels[level].width,
+				levels[level].height, 0, GL_RGB, GL_UNSIGNED_BYTE,
+				levels[level].pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+	std::cout << "loaded texture (" << levels.size() << " levels) from "
+			<< (cached ? baked : source) << " in "
+			<< std::chrono::duration<double, std::milli>(
+					std::chrono::steady_clock::now() - start).count() << " ms"
+			<< std::endl;
+
 	// setup texture uniforms
 	GLint tex0Uni = glGetUniformLocation(shader_program_, "tex0");
 	assert(tex0Uni >= 0);
 	glUniform1i(tex0Uni, 0);
 }
 
-enum TexDir
+size_t Renderer::load_chunk_vertices(ChunkCache<mesh_vertex_attrs> &cc)
 {
-	TEX_XNEG, TEX_YNEG, TEX_XPOS, TEX_YPOS, TEX_ZNEG, TEX_ZPOS
-};
+	auto &buffers = cc.gpu_buffers();
+
+	if (buffers.vao == 0)
+	{
+		glGenVertexArrays(1, &buffers.vao);
+		glBindVertexArray(buffers.vao);
+		glGenBuffers(1, &buffers.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+		set_vertex_attribs();
+	}
+
+	// upload only if a new mesh was installed since the last upload
+	if (buffers.generation == cc.mesh_generation())
+		return buffers.elements;
 
-size_t Renderer::load_chunk_vertices(const ChunkCache<5> &cc)
-{
 	const auto &vertices = cc.get_vertices();
 	const auto &a = cc.elements();
-	const auto &elem_count = cc.attribute_count();
+	const size_t bytes = a * sizeof(MeshVertex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+	glBufferData(GL_ARRAY_BUFFER, bytes, vertices.data(), GL_STATIC_DRAW);
+	uploaded_bytes_frame_ += bytes;
+
+	buffers.generation = cc.mesh_generation();
+	buffers.elements = a;
+	return a;
+}
+
+void Renderer::set_vertex_attribs()
+{
+	// for the bound VAO, from the buffer bound to GL_ARRAY_BUFFER
+	glEnableVertexAttribArray(vertex_attrib_);
+	glVertexAttribIPointer(vertex_attrib_, 1, GL_UNSIGNED_INT,
+			sizeof(MeshVertex), nullptr);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, elem_count * a * sizeof(GLbyte),
-			vertices.data(),
-			GL_DYNAMIC_DRAW);
-	return elem_count * a;
+size_t Renderer::upload_chunk_pages(ChunkCache<mesh_vertex_attrs> &cc)
+{
+	auto &buffers = cc.gpu_buffers();
+	// upload only if a new mesh was installed since the last upload
+	if (buffers.generation == cc.mesh_generation())
+		return buffers.elements;
+
+	arena_.deallocate(buffers.first_page, buffers.pages);
+	buffers.pages = 0;
+	buffers.generation = cc.mesh_generation();
+	buffers.elements = cc.elements();
+	if (buffers.elements == 0)
+		return 0;
+
+	const size_t pages = (buffers.elements + mesh_page_vertices - 1)
+			/ mesh_page_vertices;
+	size_t first = arena_.allocate(pages);
+	if (first == PageArena::npos)
+	{
+		// at least double it, so that growing stays rare
+		grow_arena(std::max( { pages, arena_.capacity(), size_t(256) }));
+		first = arena_.allocate(pages);
+	}
+	buffers.first_page = first;
+	buffers.pages = pages;
+
+	constexpr size_t page_bytes = mesh_page_vertices * sizeof(MeshVertex);
+	const size_t bytes = buffers.elements * sizeof(MeshVertex);
+	glBindBuffer(GL_ARRAY_BUFFER, arena_vbo_);
+	glBufferSubData(GL_ARRAY_BUFFER, first * page_bytes, bytes,
+			cc.get_vertices().data());
+	uploaded_bytes_frame_ += bytes;
+
+	// the chunk's block offset, once per page
+	const auto &coord = cc.chunk_coord();
+	const GLfloat offset[4] =
+	{ (GLfloat) Chunk::chunk_length * coord.x(), (GLfloat) Chunk::chunk_length
+			* coord.y(), (GLfloat) Chunk::chunk_height * coord.z(), 0 };
+	std::vector<GLfloat> offsets(4 * pages);
+	for (size_t p = 0; p < pages; p++)
+		std::copy(offset, offset + 4, offsets.begin() + 4 * p);
+	glBindBuffer(GL_TEXTURE_BUFFER, page_offset_buffer_);
+	glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(offset),
+			offsets.size() * sizeof(GLfloat), offsets.data());
+	return buffers.elements;
+}
+
+void Renderer::grow_arena(size_t pages)
+{
+	constexpr size_t page_bytes = mesh_page_vertices * sizeof(MeshVertex);
+	constexpr size_t offset_bytes = 4 * sizeof(GLfloat);
+	const size_t old_pages = arena_.capacity();
+	const size_t new_pages = old_pages + pages;
+
+	// new buffers with the old contents copied over
+	auto regrow = [](GLuint &buffer, size_t old_bytes, size_t new_bytes)
+	{
+		GLuint grown;
+		glGenBuffers(1, &grown);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+		glBufferData(GL_COPY_WRITE_BUFFER, new_bytes, nullptr, GL_DYNAMIC_DRAW);
+		if (buffer)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+					old_bytes);
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = grown;
+	};
+	regrow(arena_vbo_, old_pages * page_bytes, new_pages * page_bytes);
+	regrow(page_offset_buffer_, old_pages * offset_bytes,
+			new_pages * offset_bytes);
+	arena_.grow(pages);
+
+	if (!arena_vao_)
+		glGenVertexArrays(1, &arena_vao_);
+	glBindVertexArray(arena_vao_);
+	glBindBuffer(GL_ARRAY_BUFFER, arena_vbo_);
+	set_vertex_attribs();
+
+	if (!page_offset_texture_)
+		glGenTextures(1, &page_offset_texture_);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, page_offset_texture_);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, page_offset_buffer_);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void Renderer::stream_chunks()
+{
+	if (!streamer_)
+		return;
+
+	std::vector<ChunkCoord> loaded, unloaded;
+	streamer_->update(view_pos_.x, view_pos_.y, view_pos_.z, loaded,
+			unloaded);
+	for (const auto &coord : unloaded)
+		unload_chunk(coord);
+	for (const auto &coord : loaded)
+		load_chunk(coord);
+}
+
+EditResult Renderer::apply_edits(WorldEdit &edit)
+{
+	auto result = edit.commit(*world_, light_.get());
+	for (const auto &coord : result.created)
+		load_chunk(coord);
+	// edited chunks are changed(); neighbours re-mesh through their
+	// borders
+	for (const auto &coord : result.remesh)
+	{
+		auto *chunk = find_chunk_cache(coord);
+		if (chunk)
+			chunk->invalidate_borders();
+	}
+	return result;
+}
+
+void Renderer::load_chunk(const ChunkCoord &coord)
+{
+	const auto &chunk = world_->chunk(coord);
+	if (!chunk.has_value() || find_chunk_cache(coord))
+		return;
+	if (!chunk.value()->light())
+	{
+		// relit chunks are changed(): they and their neighbours re-mesh
+		light_->light_chunk(coord);
+		light_->take_relit();
+	}
+	chunk_index_.emplace(pack_chunk_coord(coord), chunks_.size());
+	chunks_.push_back(ChunkCache<mesh_vertex_attrs>(coord,
+			std::move(chunk.value()), registry_, meshing_mode_));
+	invalidate_neighbour_borders(coord);
+}
+
+void Renderer::unload_chunk(const ChunkCoord &coord)
+{
+	const auto it = chunk_index_.find(pack_chunk_coord(coord));
+	if (it == chunk_index_.end())
+		return;
+	const size_t index = it->second;
+	chunk_index_.erase(it);
+	release_chunk_buffers(chunks_[index]);
+	// the last chunk takes its place
+	if (index + 1 != chunks_.size())
+	{
+		chunks_[index] = std::move(chunks_.back());
+		chunk_index_[pack_chunk_coord(chunks_[index].chunk_coord())] = index;
+	}
+	chunks_.pop_back();
+	invalidate_neighbour_borders(coord);
+}
+
+ChunkCache<mesh_vertex_attrs>* Renderer::find_chunk_cache(
+		const ChunkCoord &coord)
+{
+	const auto it = chunk_index_.find(pack_chunk_coord(coord));
+	return it != chunk_index_.end() ? &chunks_[it->second] : nullptr;
+}
+
+void Renderer::invalidate_neighbour_borders(const ChunkCoord &coord)
+{
+	static constexpr CoordElem dirs[6][3] =
+	{
+	{ 1, 0, 0 },
+	{ -1, 0, 0 },
+	{ 0, 1, 0 },
+	{ 0, -1, 0 },
+	{ 0, 0, 1 },
+	{ 0, 0, -1 } };
+	for (const auto &d : dirs)
+	{
+		auto *neighbour = find_chunk_cache(
+				ChunkCoord(coord.x() + d[0], coord.y() + d[1],
+						coord.z() + d[2]));
+		if (neighbour)
+			neighbour->invalidate_borders();
+	}
+}
+
+void Renderer::schedule_chunk_meshes()
+{
+	// an edited chunk may change what its neighbours see across the
+	// border; they re-mesh only if the touching layer really changed
+	for (auto &chunk : chunks_)
+		if (chunk.chunk().changed())
+			invalidate_neighbour_borders(chunk.chunk_coord());
+
+	for (auto &chunk : chunks_)
+	{
+		if (chunk.borders_stale())
+			chunk.set_borders(chunk_borders(*world_, chunk.chunk_coord()));
+		if (!chunk.stale())
+			continue;
+		const auto ticket = chunk.request_mesh();
+		mesh_workers_->submit(chunk.chunk_coord(), ticket, chunk.chunk(),
+				chunk.borders(), chunk.meshing_mode());
+		// the worker has its own copy; nothing reads this one's blocks
+		// until the next edit
+		chunk.chunk().compact();
+	}
+}
+
+void Renderer::install_finished_meshes()
+{
+	size_t installed = 0;
+	while (installed < mesh_uploads_per_frame_)
+	{
+		const auto result = mesh_workers_->poll();
+		if (!result)
+			break;
+
+		// the chunk may have been unloaded since
+		auto *chunk = find_chunk_cache(result->coord);
+		if (chunk
+				&& chunk->install_mesh(result->ticket,
+						std::move(result->vertices)))
+		{
+			// into the shared pages, or the chunk's own buffer
+			if (multi_draw_)
+				upload_chunk_pages(*chunk);
+			else
+				load_chunk_vertices(*chunk);
+			installed++;
+		}
+	}
+}
+
+void Renderer::update_overlay()
+{
+	if (!profiler_.enabled())
+		return;
+	// a few times a second: setting the title is not free
+	const auto now = std::chrono::steady_clock::now();
+	if (now - overlay_updated_ < std::chrono::milliseconds(500))
+		return;
+	overlay_updated_ = now;
+	const auto &draws = draw_stats_last_frame_;
+	std::string title = window_title_ + " - " + profiler_.overlay_text()
+			+ " | " + std::to_string(draws.draw_calls) + " draws, "
+			+ std::to_string(draws.state_changes) + " state changes";
+	// the block under the crosshair
+	const auto hit = raycast(*world_, Ray
+	{
+	{ view_pos_.x, view_pos_.y, view_pos_.z },
+	{ view_look_at_vec_.x, view_look_at_vec_.y, view_look_at_vec_.z } },
+			pick_reach);
+	if (hit)
+		title += " | block " + std::to_string(hit->id) + " at "
+				+ std::to_string(hit->block[0]) + " "
+				+ std::to_string(hit->block[1]) + " "
+				+ std::to_string(hit->block[2]);
+	glfwSetWindowTitle(window_, title.c_str());
+}
+
+void Renderer::print_mesh_memory(std::ostream &os) const
+{
+	size_t bytes = 0;
+	for (const auto &chunk : chunks_)
+		bytes += chunk.mesh_bytes();
+
+	const auto &pool = MeshPool::shared();
+	os << "mesh memory: " << chunks_.size() << " chunks, " << bytes
+			<< " bytes resident";
+	if (!chunks_.empty())
+		os << " (" << bytes / chunks_.size() << " bytes/chunk)";
+	os << ", pool " << pool.bytes_in_use() << " in use / "
+			<< pool.bytes_reserved() << " reserved (" << pool.bytes_free()
+			<< " free)" << std::endl;
+}
+
+void Renderer::release_chunk_buffers(ChunkCache<mesh_vertex_attrs> &cc)
+{
+	auto &buffers = cc.gpu_buffers();
+	arena_.deallocate(buffers.first_page, buffers.pages);
+	buffers.pages = 0;
+	if (buffers.vao == 0)
+	{
+		buffers = {};
+		return;
+	}
+	glDeleteBuffers(1, &buffers.vbo);
+	glDeleteVertexArrays(1, &buffers.vao);
+	buffers = {};
 }
 
 void mycraft::keyboard_handler(GLFWwindow *window, int key, int scancode,
@@ -336,6 +875,14 @@ void mycraft::keyboard_handler(GLFWwindow *window, int key, int scancode,
 				}
 			};
 
+	// F3: frame timings on / off
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+	{
+		self->profiler_.set_enabled(!self->profiler_.enabled());
+		if (!self->profiler_.enabled())
+			glfwSetWindowTitle(window, self->window_title_.c_str());
+	}
+
 	using KB = KeyboardHandlerData::KeyboardButton;
 	ed(GLFW_KEY_W, KB::KEY_W);
 	ed(GLFW_KEY_S, KB::KEY_S);
@@ -391,7 +938,17 @@ void mycraft::keyboard_handler_tick()
 		vel.z -= speed * dt;
 	}
 
-	view_pos += vel;
+	// the player box stops at solid blocks, however fast it moves
+	Aabb player
+	{
+	{ view_pos.x - player_width / 2, view_pos.y - player_width / 2, view_pos.z
+			- player_eye_height },
+	{ view_pos.x + player_width / 2, view_pos.y + player_width / 2, view_pos.z
+			- player_eye_height + player_height } };
+	const float motion[3] =
+	{ vel.x, vel.y, vel.z };
+	const auto moved = self->collision_->move(player, motion).moved;
+	view_pos += glm::vec3(moved[0], moved[1], moved[2]);
 }
 
 void mycraft::mousemotion_handler(GLFWwindow *window, double xpos, double ypos)
@@ -431,199 +988,28 @@ void mycraft::mousemotion_handler(GLFWwindow *window, double xpos, double ypos)
 template<size_t elem_count>
 void ChunkCache<elem_count>::compute_save_vertices_cache()
 {
-	// return if cache is already generated and up-to-date.
-	if (cache_generated_ && !chunk_->changed())
+	// return if the mesh is already up-to-date.
+	if (!stale() && !mesh_pending())
 		return;
 
-	constexpr auto &cl = Chunk::chunk_length;
-	constexpr auto &ch = Chunk::chunk_height;
-	std::array<std::array<GLbyte, elem_count>, cl * cl * ch * 6 * 6> vertices;
-	size_t a = 0;
-
-	GLbyte gx, gy, gz;
-	auto s =
-			[&a, &vertices, chunk=this->chunk_, &gx, &gy, &gz, ts_=this->ts_](
-					GLbyte x, GLbyte y, GLbyte z, TexDir tex_dir, bool tex_x,
-					bool tex_y)
-					{
-						auto& array = vertices[a++];
-						array[0] = x; // pos x
-						array[1] = y;// pos y
-						array[2] = z;// pos z
-						const auto blk_id = chunk->data()[Chunk::convert_index(gx, gy, gz)].block_id();
-						// TODO: texture id
-						const auto& tex_ = ts_->texture(blk_id-1);
-						TextureMapCoord tex;
-						switch (tex_dir)
-						{
-							case TEX_XNEG:
-							tex = tex_.xneg();
-							break;
-							case TEX_YNEG:
-							tex = tex_.yneg();
-							break;
-							case TEX_XPOS:
-							tex = tex_.xpos();
-							break;
-							case TEX_YPOS:
-							tex = tex_.ypos();
-							break;
-							case TEX_ZNEG:
-							tex = tex_.zneg();
-							break;
-							case TEX_ZPOS:
-							tex = tex_.zpos();
-							break;
-						}
-						array[3] = !tex_x ? tex.first.first : tex.second.first; // tex x
-						array[4] = !tex_y ? tex.first.second : tex.second.second;// tex y
-					};
-
-	auto exists = [chunk=this->chunk_](GLbyte x, GLbyte y, GLbyte z)
-	{
-		return chunk->data()[Chunk::convert_index(x, y, z)].block_id() != 0;
-	};
-
-	const auto &chunk = this->chunk_;
-	for (int i = 0; i < Chunk::chunk_length; i++)
-	{
-		for (int j = 0; j < Chunk::chunk_length; j++)
-		{
-			// flag for z-axis merging
-			//std::optional<Block> last_blk = {};
-			//std::array<size_t, 6> drawn = {};
-
-			for (int k = 0; k < Chunk::chunk_height; k++)
-			{
-				const auto &blk = chunk->data()[Chunk::convert_index(i, j, k)];
-
-				if (blk.block_id() == 0)
-				{
-					continue;
-				}
-
-				//const bool can_merge = last_blk.has_value() && last_blk.value().block_id() == blk.block_id();
-
-				gx = i;
-				gy = j;
-				gz = k;
+	// worst-case scratch space, kept per thread and reused
+	thread_local std::vector<MeshVertex> scratch(max_chunk_vertices);
 
-				//last_blk = std::optional<Block>(blk);
-
-				// view from negative y
-//				if (can_merge)
-//				{
-//					vertices[drawn.at(0)+1][2] = k+1;
-//					vertices[drawn.at(0)+2][2] = k+1;
-//					vertices[drawn.at(0)+3][2] = k+1;
-//				}
-//				else
-				if (j == 0 || !exists(i, j - 1, k))
-				{
-					//drawn.at(0) = a;
-					s(i, j, k, TEX_YNEG, false, false);
-					s(i, j, k + 1, TEX_YNEG, false, true);
-					s(i + 1, j, k + 1, TEX_YNEG, true, true);
-					s(i + 1, j, k + 1, TEX_YNEG, true, true);
-					s(i + 1, j, k, TEX_YNEG, true, false);
-					s(i, j, k, TEX_YNEG, false, false);
-				}
-
-				// view from positive x
-//				if (can_merge)
-//				{
-//					vertices[drawn.at(1)+1][2] = k+1;
-//					vertices[drawn.at(1)+2][2] = k+1;
-//					vertices[drawn.at(1)+3][2] = k+1;
-//				}
-//				else
-				if (i == Chunk::chunk_length - 1 || !exists(i + 1, j, k))
-				{
-					//drawn.at(1) = a;
-					s(i + 1, j, k, TEX_XPOS, false, false);
-					s(i + 1, j, k + 1, TEX_XPOS, false, true);
-					s(i + 1, j + 1, k + 1, TEX_XPOS, true, true);
-					s(i + 1, j + 1, k + 1, TEX_XPOS, true, true);
-					s(i + 1, j + 1, k, TEX_XPOS, true, false);
-					s(i + 1, j, k, TEX_XPOS, false, false);
-				}
-
-				// view from positive y
-//				if (can_merge)
-//				{
-//					vertices[drawn.at(2)+1][2] = k+1;
-//					vertices[drawn.at(2)+2][2] = k+1;
-//					vertices[drawn.at(2)+3][2] = k+1;
-//				}
-//				else
-				if (j == Chunk::chunk_length - 1 || !exists(i, j + 1, k))
-				{
-					//drawn.at(2) = a;
-					s(i + 1, j + 1, k, TEX_YPOS, false, false);
-					s(i + 1, j + 1, k + 1, TEX_YPOS, false, true);
-					s(i, j + 1, k + 1, TEX_YPOS, true, true);
-					s(i, j + 1, k + 1, TEX_YPOS, true, true);
-					s(i, j + 1, k, TEX_YPOS, true, false);
-					s(i + 1, j + 1, k, TEX_YPOS, false, false);
-				}
-
-				// view from negative x
-//				if (can_merge)
-//				{
-//					vertices[drawn.at(3)+1][2] = k+1;
-//					vertices[drawn.at(3)+2][2] = k+1;
-//					vertices[drawn.at(3)+3][2] = k+1;
-//				}
-//				else
-				if (i == 0 || !exists(i - 1, j, k))
-				{
-					//drawn.at(3) = a;
-					s(i, j + 1, k, TEX_XNEG, false, false);
-					s(i, j + 1, k + 1, TEX_XNEG, false, true);
-					s(i, j, k + 1, TEX_XNEG, true, true);
-					s(i, j, k + 1, TEX_XNEG, true, true);
-					s(i, j, k, TEX_XNEG, true, false);
-					s(i, j + 1, k, TEX_XNEG, false, false);
-				}
-
-				// view from negative z
-//				if (can_merge)
-//				{}
-//				else
-				if (k == 0 || !exists(i, j, k - 1))
-				{
-					//drawn.at(4) = a;
-					s(i, j, k, TEX_ZNEG, false, false);
-					s(i + 1, j, k, TEX_ZNEG, true, false);
-					s(i + 1, j + 1, k, TEX_ZNEG, true, true);
-					s(i + 1, j + 1, k, TEX_ZNEG, true, true);
-					s(i, j + 1, k, TEX_ZNEG, false, true);
-					s(i, j, k, TEX_ZNEG, false, false);
-				}
+	const auto ticket = request_mesh();
+	const size_t count = mesh_chunk(*chunk_, *registry_, meshing_mode_,
+			scratch.data(), &borders_);
+	install_mesh(ticket, MeshBuffer::copy_of(scratch.data(), count));
+}
 
-				// view from positive z
-//				if (can_merge)
-//				{
-//					for (int i=0; i<6; i++)
-//						vertices[drawn.at(5)+i][2] = k+1;
-//				}
-//				else
-				if (k == Chunk::chunk_height - 1 || !exists(i, j, k + 1))
-				{
-					//drawn.at(5) = a;
-					s(i, j, k + 1, TEX_ZPOS, false, false);
-					s(i, j + 1, k + 1, TEX_ZPOS, false, true);
-					s(i + 1, j + 1, k + 1, TEX_ZPOS, true, true);
-					s(i + 1, j + 1, k + 1, TEX_ZPOS, true, true);
-					s(i + 1, j, k + 1, TEX_ZPOS, true, false);
-					s(i, j, k + 1, TEX_ZPOS, false, false);
-				}
-			}
-		}
-	}
+template<size_t elem_count>
+bool ChunkCache<elem_count>::install_mesh(std::uint64_t ticket,
+		MeshBuffer &&vertices)
+{
+	if (ticket != mesh_ticket_)
+		return false;
 
-	chunk_->set_changed(false);
-	vertices_cache_ = vertices;
-	elements_cache_ = a;
-	cache_generated_ = true;
+	vertices_cache_ = std::move(vertices);
+	installed_ticket_ = ticket;
+	mesh_generation_++;
+	return true;
 }
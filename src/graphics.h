@@ -12,8 +12,18 @@
 #include <memory>
 #include "world.h"
 #include "TextureMap.h"
+#include "mesher.h"
+#include "mesh_worker.h"
+#include "culling.h"
+#include "chunk_streamer.h"
+#include "world_edit.h"
+#include "frame_profiler.h"
+#include "page_arena.h"
+#include "light.h"
+#include "collision.h"
 #include <chrono>
 #include <array>
+#include <unordered_map>
 #include <vector>
 
 namespace mycraft
@@ -23,52 +33,178 @@ namespace mycraft
 	void keyboard_handler_tick();
 	void mousemotion_handler(GLFWwindow *window, double xpos, double ypos);
 
+	// Vertices per page of the shared chunk vertex buffer. Every page
+	// holds vertices of one chunk only, so the vertex shader finds the
+	// chunk's offset from gl_VertexID / mesh_page_vertices.
+	constexpr size_t mesh_page_vertices = 1024;
+
+	// How far (in blocks) the overlay looks for the block under the
+	// crosshair.
+	constexpr float pick_reach = 8;
+
+	// The box the camera collides with: player_width across, its top
+	// player_height - player_eye_height above the camera.
+	constexpr float player_width = 0.6f;
+	constexpr float player_height = 1.8f;
+	constexpr float player_eye_height = 1.62f;
+
+	// GL calls made by Renderer::render_world() in one frame.
+	struct DrawStats
+	{
+		size_t draw_calls = 0;
+		// VAO and buffer binds, enables and uniform updates
+		size_t state_changes = 0;
+		size_t chunks_drawn = 0;
+	};
+
 	template <size_t attr_count>
 	class ChunkCache
 	{
 	public:
-		using vertices_array_t = std::array<std::array<GLbyte, attr_count>, Chunk::chunk_length * Chunk::chunk_length * Chunk::chunk_height * 6 * 6>;
+		static_assert(attr_count == mesh_vertex_attrs,
+				"ChunkCache vertex layout must match the mesher");
 
 		static size_t attribute_count() {return attr_count;}
 
-		const vertices_array_t& get_vertices() const {
-			if (!cache_generated_)
-				const_cast<ChunkCache*>(this)->compute_save_vertices_cache();
+		// The last installed mesh. Meshes are built by compute_save_vertices_cache()
+		// or, off-thread, by a MeshWorkerPool and handed in with install_mesh().
+		const MeshBuffer& get_vertices() const {
 			return vertices_cache_;
 		}
 
 		size_t elements() const {
-			if (!cache_generated_)
-				const_cast<ChunkCache*>(this)->compute_save_vertices_cache();
-			return elements_cache_;
+			return vertices_cache_.size();
+		}
+
+		// resident bytes of the installed mesh.
+		size_t mesh_bytes() const {
+			return vertices_cache_.bytes();
+		}
+
+		// true if a new mesh has to be requested: the chunk was never
+		// meshed or it or its borders changed since the last request.
+		bool stale() const {
+			return !mesh_requested_ || chunk_->changed();
+		}
+
+		// The neighbour border layers the mesh is culled against.
+		const ChunkBorders& borders() const {
+			return borders_;
+		}
+
+		// true if a neighbour was loaded, unloaded or edited since the
+		// borders were last set.
+		bool borders_stale() const {
+			return borders_stale_;
+		}
+
+		void invalidate_borders() {
+			borders_stale_ = true;
+		}
+
+		// Takes the current neighbour borders. The chunk only becomes
+		// stale if they differ from the ones it was meshed with.
+		void set_borders(const ChunkBorders &borders) {
+			borders_stale_ = false;
+			if (borders == borders_)
+				return;
+			borders_ = borders;
+			mesh_requested_ = false;
+		}
+
+		// true while the latest requested mesh has not been installed.
+		bool mesh_pending() const {
+			return installed_ticket_ != mesh_ticket_;
+		}
+
+		// Marks the current chunk contents as being meshed and returns the
+		// ticket the resulting mesh must be installed with.
+		std::uint64_t request_mesh() {
+			// unique across caches, so that a result for an unloaded
+			// chunk never matches a later cache of the same coordinate
+			static std::uint64_t last_ticket = 0;
+			chunk_->set_changed(false);
+			mesh_requested_ = true;
+			return mesh_ticket_ = ++last_ticket;
+		}
+
+		// Installs a mesh built for ticket. Results of older requests are
+		// dropped; returns whether the mesh was taken.
+		bool install_mesh(std::uint64_t ticket, MeshBuffer &&vertices);
+
+		// Builds and installs the mesh on the calling thread.
+		void compute_save_vertices_cache();
+
+		const Chunk& chunk() const {
+			return *chunk_;
+		}
+
+		// incremented every time a mesh is installed.
+		size_t mesh_generation() const {
+			return mesh_generation_;
+		}
+
+		// GPU objects holding the uploaded mesh. They are owned by the
+		// Renderer, which creates and deletes them.
+		struct GpuBuffers
+		{
+			GLuint vao = 0;
+			GLuint vbo = 0;
+			size_t generation = 0; // mesh generation that was uploaded
+			size_t elements = 0;
+			// pages of the shared vertex buffer (multi-draw path)
+			size_t first_page = 0;
+			size_t pages = 0;
+		};
+
+		GpuBuffers& gpu_buffers() {
+			return gpu_buffers_;
 		}
 
 		const ChunkCoord& chunk_coord() const {
 			return chunk_coord_;
 		}
 
-		ChunkCache() : elements_cache_(0) {}
-		ChunkCache(std::shared_ptr<Chunk> chunk, std::shared_ptr<TextureStorage> ts)
+		MeshingMode meshing_mode() const {
+			return meshing_mode_;
+		}
+
+		void set_meshing_mode(MeshingMode mode) {
+			if (mode != meshing_mode_)
+				mesh_requested_ = false;
+			meshing_mode_ = mode;
+		}
+
+		ChunkCache() {}
+		ChunkCache(std::shared_ptr<Chunk> chunk, std::shared_ptr<const BlockRegistry> registry)
 			: chunk_(std::move(chunk))
-			, ts_(std::move(ts))
-			, elements_cache_(0) {}
-		ChunkCache(ChunkCoord cc, std::shared_ptr<Chunk> chunk, std::shared_ptr<TextureStorage> ts)
+			, registry_(std::move(registry)) {}
+		ChunkCache(ChunkCoord cc, std::shared_ptr<Chunk> chunk, std::shared_ptr<const BlockRegistry> registry)
+					: chunk_coord_(std::move(cc))
+					, chunk_(std::move(chunk))
+					, registry_(std::move(registry)) {}
+		ChunkCache(ChunkCoord cc, std::shared_ptr<Chunk> chunk, std::shared_ptr<const BlockRegistry> registry, MeshingMode mode)
 					: chunk_coord_(std::move(cc))
 					, chunk_(std::move(chunk))
-					, ts_(std::move(ts))
-					, elements_cache_(0) {}
+					, registry_(std::move(registry))
+					, meshing_mode_(mode) {}
 
 	private:
 		ChunkCoord chunk_coord_;
 		std::shared_ptr<Chunk> chunk_;
-		std::shared_ptr<TextureStorage> ts_;
-		mutable std::array<std::array<GLbyte, attr_count>, Chunk::chunk_length * Chunk::chunk_length * Chunk::chunk_height * 6 * 6> vertices_cache_;
-		mutable size_t elements_cache_;
-		bool cache_generated_ = false;
-
-		void compute_save_vertices_cache();
+		std::shared_ptr<const BlockRegistry> registry_;
+		MeshBuffer vertices_cache_;
+		bool mesh_requested_ = false;
+		std::uint64_t mesh_ticket_ = 0;
+		std::uint64_t installed_ticket_ = 0;
+		size_t mesh_generation_ = 0;
+		MeshingMode meshing_mode_ = MeshingMode::GREEDY;
+		ChunkBorders borders_;
+		bool borders_stale_ = true;
+		GpuBuffers gpu_buffers_;
 	};
 
+
 	// TODO: this class should be a singleton.
 	class Renderer
 	{
@@ -90,8 +226,28 @@ namespace mycraft
 			world_ = std::move(world);
 		}
 
+		// With a generator, chunks are streamed in and out around the
+		// player; without one, the chunks around the origin are shown.
+		void set_world_generator(std::shared_ptr<const WorldGenerator> generator)
+		{
+			generator_ = std::move(generator);
+		}
+
+		void set_streaming_config(const StreamingConfig &config)
+		{
+			streaming_config_ = config;
+		}
+
+		// Where edited chunks are saved (on eviction and on exit) and
+		// streamed chunks are loaded from.
+		void set_region_store(std::shared_ptr<RegionStore> store)
+		{
+			store_ = std::move(store);
+		}
+
 		void set_texture_storage(std::shared_ptr<TextureStorage> ts)
 		{
+			registry_ = std::make_shared<const BlockRegistry>(*ts);
 			ts_ = std::move(ts);
 		}
 
@@ -100,19 +256,118 @@ namespace mycraft
 			return world_;
 		}
 
+		// bytes of vertex data sent to the GPU during the last frame.
+		size_t uploaded_bytes_last_frame() const
+		{
+			return uploaded_bytes_last_frame_;
+		}
+
+		void set_meshing_mode(MeshingMode mode)
+		{
+			meshing_mode_ = mode;
+			for (auto &chunk : chunks_)
+				chunk.set_meshing_mode(mode);
+		}
+
+		// chunks farther than this many blocks from the camera are not drawn.
+		void set_view_distance(float blocks)
+		{
+			view_distance_ = blocks;
+		}
+
+		// chunks tested, culled and drawn during the last frame.
+		const CullStats& cull_stats_last_frame() const
+		{
+			return cull_stats_last_frame_;
+		}
+
+		// Commits edit to the world. Every chunk it affects is re-meshed
+		// once, in the next frame.
+		EditResult apply_edits(WorldEdit &edit);
+
+		// Draw every visible chunk with one glMultiDrawElementsBaseVertex
+		// out of a shared vertex buffer (the default), or with a VAO, a
+		// model matrix and a draw call per chunk. Set before render_loop().
+		void set_multi_draw(bool multi_draw)
+		{
+			multi_draw_ = multi_draw;
+		}
+
+		const DrawStats& draw_stats_last_frame() const
+		{
+			return draw_stats_last_frame_;
+		}
+
+		// Per-stage frame timings. F3 toggles them, with a readout in the
+		// window title.
+		FrameProfiler& profiler()
+		{
+			return profiler_;
+		}
+
+		// Enables the frame timings and writes them to path on exit
+		// (see FrameProfiler::write_file).
+		void set_profile_output(const std::string &path)
+		{
+			profile_output_ = path;
+			profiler_.set_enabled(true);
+		}
+
+		// Prints the resident mesh memory of the loaded chunks.
+		void print_mesh_memory(std::ostream &os) const;
+
+		// maximum number of finished meshes installed and uploaded per frame.
+		void set_mesh_uploads_per_frame(size_t uploads)
+		{
+			mesh_uploads_per_frame_ = uploads;
+		}
+
 	private:
 		GLFWwindow *window_;
 		// World data
 		std::shared_ptr<World> world_;
-		std::vector<ChunkCache<5>> chunks_;
-		ChunkCoord load_chunks_center_;
+		// lights chunks as they are loaded and edited (from render_loop())
+		std::unique_ptr<LightEngine> light_;
+		std::unique_ptr<CollisionWorld> collision_;
+		std::vector<ChunkCache<mesh_vertex_attrs>> chunks_;
+		// index into chunks_ by pack_chunk_coord()
+		std::unordered_map<uint64_t, size_t> chunk_index_;
+		std::shared_ptr<const WorldGenerator> generator_;
+		StreamingConfig streaming_config_;
+		std::unique_ptr<ChunkStreamer> streamer_;
+		std::shared_ptr<RegionStore> store_;
+		MeshingMode meshing_mode_ = MeshingMode::GREEDY;
+		std::unique_ptr<MeshWorkerPool> mesh_workers_;
+		size_t mesh_uploads_per_frame_ = 8;
 
 		// Texture data
 		std::shared_ptr<TextureStorage> ts_;
+		// built from ts_ for the mesher
+		std::shared_ptr<const BlockRegistry> registry_;
 
 		// OpenGL
 		GLuint shader_program_;
-		GLuint vbo;
+		GLint vertex_attrib_;
+		// quad_indices(), shared by every chunk VAO
+		GLuint index_buffer_ = 0;
+		size_t uploaded_bytes_frame_ = 0;
+		size_t uploaded_bytes_last_frame_ = 0;
+		glm::mat4 proj_mat_;
+		float view_distance_ = 50.0f;
+		CullStats cull_stats_last_frame_;
+		GLint paged_uni_;
+		bool multi_draw_ = true;
+		// the shared vertex buffer and the block offset of the chunk in
+		// each of its pages (a texture buffer of vec4)
+		PageArena arena_;
+		GLuint arena_vao_ = 0;
+		GLuint arena_vbo_ = 0;
+		GLuint page_offset_buffer_ = 0;
+		GLuint page_offset_texture_ = 0;
+		std::vector<GLint> draw_base_vertices_;
+		std::vector<GLsizei> draw_counts_;
+		std::vector<const GLvoid*> draw_index_offsets_;
+		DrawStats draw_stats_last_frame_;
 
 		float walk_speed = 100.0;
 		// player's position
@@ -126,6 +381,10 @@ namespace mycraft
 
 		// time
 		std::chrono::high_resolution_clock::time_point last_update_time;
+		FrameProfiler profiler_;
+		std::string profile_output_;
+		std::string window_title_;
+		std::chrono::steady_clock::time_point overlay_updated_;
 
 		// keyboard input
 		std::unique_ptr<KeyboardHandlerData> keyboard_handler_data_;
@@ -138,8 +397,21 @@ namespace mycraft
 		void prepare_shaders();
 		void load_textures();
 		void render_world();
+		void stream_chunks();
+		void load_chunk(const ChunkCoord &coord);
+		void unload_chunk(const ChunkCoord &coord);
+		ChunkCache<mesh_vertex_attrs>* find_chunk_cache(const ChunkCoord &coord);
+		void invalidate_neighbour_borders(const ChunkCoord &coord);
+		void schedule_chunk_meshes();
+		void update_overlay();
+		void set_vertex_attribs();
+		size_t upload_chunk_pages(ChunkCache<mesh_vertex_attrs> &cc);
+		void grow_arena(size_t pages);
+		void install_finished_meshes();
+
 
-		size_t load_chunk_vertices(const ChunkCache<5>& cc);
+		size_t load_chunk_vertices(ChunkCache<mesh_vertex_attrs>& cc);
+		void release_chunk_buffers(ChunkCache<mesh_vertex_attrs>& cc);
 
 		friend void keyboard_handler(GLFWwindow *window, int key, int scancode, int action, int mods);
 		friend void mousemotion_handler(GLFWwindow *window, double xpos, double ypos);
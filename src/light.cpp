@@ -0,0 +1,344 @@
+#include "light.h"
+
+#include <algorithm>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr CoordElem chunk_dims[3] =
+{ Chunk::chunk_length, Chunk::chunk_length, Chunk::chunk_height };
+
+// -x, +x, -y, +y, -z, +z: direction d is along axis d / 2, positive if
+// d is odd
+constexpr int directions[6][3] =
+{
+{ -1, 0, 0 },
+{ 1, 0, 0 },
+{ 0, -1, 0 },
+{ 0, 1, 0 },
+{ 0, 0, -1 },
+{ 0, 0, 1 } };
+constexpr int down = 4, up = 5;
+
+constexpr LightChannel channels[2] =
+{ LightChannel::SKY, LightChannel::BLOCK };
+
+constexpr std::uint8_t max_level = ChunkLight::max_level;
+
+}
+
+LightEngine::LightEngine(World &world, LightProperties properties) :
+		world_(world), properties_(std::move(properties))
+{
+}
+
+LightEngine::Cell LightEngine::locate(std::int64_t x, std::int64_t y,
+		std::int64_t z)
+{
+	Cell cell;
+	cell.coord = block_chunk(x, y, z, cell.local);
+	const auto key = pack_chunk_coord(cell.coord);
+	if (!last_valid_ || key != last_key_)
+	{
+		last_key_ = key;
+		last_ = world_.find_chunk(cell.coord);
+		last_valid_ = true;
+	}
+	cell.chunk = last_;
+	cell.index = Chunk::convert_index(cell.local[0], cell.local[1],
+			cell.local[2]);
+	return cell;
+}
+
+void LightEngine::set_level(Cell &cell, LightChannel channel,
+		std::uint8_t level)
+{
+	cell.chunk->light()->set(channel, cell.index, level);
+	cell.chunk->set_changed(true);
+	relit_[pack_chunk_coord(cell.coord)].add(cell.local[0], cell.local[1],
+			cell.local[2]);
+}
+
+void LightEngine::queue_neighbours(const Node &at, LightChannel channel)
+{
+	auto &add = queues(channel).add;
+	for (int d = 0; d < 6; d++)
+	{
+		const Node n =
+		{ at.x + directions[d][0], at.y + directions[d][1], at.z
+				+ directions[d][2], 0 };
+		const Cell cell = locate(n.x, n.y, n.z);
+		if (!cell.chunk)
+		{
+			if (channel == LightChannel::SKY && d == up)
+				add.push_back( { n.x, n.y, n.z, max_level });
+			continue;
+		}
+		const ChunkLight *light = cell.chunk->light();
+		if (!light)
+			continue;
+		const auto level = light->get(channel, cell.index);
+		if (level > 1)
+			add.push_back( { n.x, n.y, n.z, level });
+	}
+}
+
+void LightEngine::run_removals(LightChannel channel)
+{
+	auto &q = queues(channel);
+	const bool sky = channel == LightChannel::SKY;
+	// q.remove grows while it is walked
+	for (size_t i = 0; i < q.remove.size(); i++)
+	{
+		const Node n = q.remove[i];
+		visited_++;
+		for (int d = 0; d < 6; d++)
+		{
+			const Node next =
+			{ n.x + directions[d][0], n.y + directions[d][1], n.z
+					+ directions[d][2], 0 };
+			Cell cell = locate(next.x, next.y, next.z);
+			if (!cell.chunk)
+			{
+				// the open sky shines back in
+				if (sky && d == up)
+					q.add.push_back( { next.x, next.y, next.z, max_level });
+				continue;
+			}
+			const ChunkLight *light = cell.chunk->light();
+			if (!light)
+				continue;
+			const auto level = light->get(channel, cell.index);
+			if (level == 0)
+				continue;
+
+			const bool fed_by_n = level < n.level
+					|| (sky && d == down && n.level == max_level
+							&& level == max_level);
+			if (!fed_by_n)
+			{
+				// lit from elsewhere: fills the hole again
+				q.add.push_back( { next.x, next.y, next.z, level });
+				continue;
+			}
+			set_level(cell, channel, 0);
+			q.remove.push_back( { next.x, next.y, next.z, level });
+			if (!sky)
+			{
+				const auto emission = properties_.emission[cell.chunk->block_id(
+						cell.local[0], cell.local[1], cell.local[2])];
+				if (emission)
+				{
+					set_level(cell, channel, emission);
+					q.add.push_back( { next.x, next.y, next.z, emission });
+				}
+			}
+		}
+	}
+	q.remove.clear();
+}
+
+void LightEngine::run_additions(LightChannel channel)
+{
+	auto &add = queues(channel).add;
+	const bool sky = channel == LightChannel::SKY;
+	for (size_t i = 0; i < add.size(); i++)
+	{
+		const Node n = add[i];
+		visited_++;
+		const Cell at = locate(n.x, n.y, n.z);
+		// skip nodes whose level changed since they were queued (nodes
+		// in chunks that are not stored are the open sky)
+		if (at.chunk
+				&& (!at.chunk->light()
+						|| at.chunk->light()->get(channel, at.index)
+								!= n.level))
+			continue;
+
+		for (int d = 0; d < 6; d++)
+		{
+			const bool falls = sky && d == down && n.level == max_level;
+			if (n.level <= 1 && !falls)
+				continue;
+			const std::uint8_t level = falls ? max_level : n.level - 1;
+
+			const Node next =
+			{ n.x + directions[d][0], n.y + directions[d][1], n.z
+					+ directions[d][2], level };
+			Cell cell = locate(next.x, next.y, next.z);
+			if (!cell.chunk || !cell.chunk->light())
+				continue;
+			if (!properties_.transparent[cell.chunk->block_id(cell.local[0],
+					cell.local[1], cell.local[2])])
+				continue;
+			if (cell.chunk->light()->get(channel, cell.index) >= level)
+				continue;
+			set_level(cell, channel, level);
+			add.push_back(next);
+		}
+	}
+	add.clear();
+}
+
+void LightEngine::propagate()
+{
+	last_valid_ = false;
+	for (const auto channel : channels)
+	{
+		run_removals(channel);
+		run_additions(channel);
+	}
+}
+
+void LightEngine::light_chunk(const ChunkCoord &c)
+{
+	last_valid_ = false;
+	Chunk *chunk = world_.find_chunk(c);
+	if (!chunk)
+		return;
+
+	auto &light = chunk->reset_light();
+	chunk->set_changed(true);
+	auto &region = relit_[pack_chunk_coord(c)];
+	region.add(0, 0, 0);
+	region.add(chunk_dims[0] - 1, chunk_dims[1] - 1, chunk_dims[2] - 1);
+
+	const std::int64_t base[3] =
+	{ (std::int64_t) c.x() * chunk_dims[0], (std::int64_t) c.y()
+			* chunk_dims[1], (std::int64_t) c.z() * chunk_dims[2] };
+
+	const bool emitters = std::any_of(properties_.emission.begin(),
+			properties_.emission.end(), [](std::uint8_t e) { return e != 0; });
+	if (emitters)
+	{
+		auto &add = queues(LightChannel::BLOCK).add;
+		for (CoordElem x = 0; x < chunk_dims[0]; x++)
+			for (CoordElem y = 0; y < chunk_dims[1]; y++)
+				for (CoordElem z = 0; z < chunk_dims[2]; z++)
+				{
+					const auto e = properties_.emission[chunk->block_id(x, y,
+							z)];
+					if (!e)
+						continue;
+					light.set(LightChannel::BLOCK,
+							Chunk::convert_index(x, y, z), e);
+					add.push_back( { base[0] + x, base[1] + y, base[2] + z, e });
+				}
+	}
+
+	// the layers of the six neighbours against this chunk: skylight from
+	// above, and whatever light the lit neighbours hold
+	for (int d = 0; d < 6; d++)
+	{
+		const int axis = d / 2;
+		const int a0 = axis == 0 ? 1 : 0, a1 = axis == 2 ? 1 : 2;
+		for (CoordElem i = 0; i < chunk_dims[a0]; i++)
+			for (CoordElem j = 0; j < chunk_dims[a1]; j++)
+			{
+				std::int64_t p[3];
+				p[axis] = base[axis] + (d % 2 ? chunk_dims[axis] : -1);
+				p[a0] = base[a0] + i;
+				p[a1] = base[a1] + j;
+				const Cell cell = locate(p[0], p[1], p[2]);
+				if (!cell.chunk)
+				{
+					if (d == up)
+						queues(LightChannel::SKY).add.push_back(
+								{ p[0], p[1], p[2], max_level });
+					continue;
+				}
+				if (!cell.chunk->light())
+					continue;
+				for (const auto channel : channels)
+				{
+					const auto level = cell.chunk->light()->get(channel,
+							cell.index);
+					if (level > 1)
+						queues(channel).add.push_back(
+								{ p[0], p[1], p[2], level });
+				}
+			}
+	}
+	for (const auto channel : channels)
+		run_additions(channel);
+
+	// a lit chunk below took the open sky above it for granted
+	Chunk *below = world_.find_chunk(ChunkCoord(c.x(), c.y(), c.z() - 1));
+	if (below && below->light())
+	{
+		auto &remove = queues(LightChannel::SKY).remove;
+		for (CoordElem x = 0; x < chunk_dims[0]; x++)
+			for (CoordElem y = 0; y < chunk_dims[1]; y++)
+			{
+				if (light.get(LightChannel::SKY, Chunk::convert_index(x, y, 0))
+						== max_level)
+					continue;
+				Cell cell = locate(base[0] + x, base[1] + y, base[2] - 1);
+				if (cell.chunk->light()->get(LightChannel::SKY, cell.index)
+						!= max_level)
+					continue;
+				set_level(cell, LightChannel::SKY, 0);
+				remove.push_back( { base[0] + x, base[1] + y, base[2] - 1,
+						max_level });
+			}
+	}
+	propagate();
+}
+
+void LightEngine::block_changed(std::int64_t x, std::int64_t y,
+		std::int64_t z, block_id_t old_id)
+{
+	last_valid_ = false;
+	Cell cell = locate(x, y, z);
+	if (!cell.chunk || !cell.chunk->light())
+		return;
+	const auto id = cell.chunk->block_id(cell.local[0], cell.local[1],
+			cell.local[2]);
+	if (properties_.transparent[id] == properties_.transparent[old_id]
+			&& properties_.emission[id] == properties_.emission[old_id])
+		return;
+
+	const Node at =
+	{ x, y, z, 0 };
+	for (const auto channel : channels)
+	{
+		auto &q = queues(channel);
+		const auto old_level = cell.chunk->light()->get(channel, cell.index);
+		if (old_level)
+		{
+			set_level(cell, channel, 0);
+			q.remove.push_back( { x, y, z, old_level });
+		}
+		const auto emission = properties_.emission[id];
+		if (channel == LightChannel::BLOCK && emission)
+		{
+			set_level(cell, channel, emission);
+			q.add.push_back( { x, y, z, emission });
+		}
+		if (properties_.transparent[id])
+			queue_neighbours(at, channel);
+	}
+}
+
+std::vector<std::pair<ChunkCoord, DirtyRegion>> LightEngine::take_relit()
+{
+	std::vector<std::pair<ChunkCoord, DirtyRegion>> relit;
+	relit.reserve(relit_.size());
+	for (const auto &entry : relit_)
+		relit.emplace_back(unpack_chunk_coord(entry.first), entry.second);
+	relit_.clear();
+	return relit;
+}
+
+std::uint8_t LightEngine::light(LightChannel channel, std::int64_t x,
+		std::int64_t y, std::int64_t z) const
+{
+	CoordElem local[3];
+	const Chunk *chunk = world_.find_chunk(block_chunk(x, y, z, local));
+	if (!chunk || !chunk->light())
+		return 0;
+	return chunk->light()->get(channel,
+			Chunk::convert_index(local[0], local[1], local[2]));
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "block.h"
+#include "block_registry.h"
+#include "world.h"
+#include "world_edit.h"
+
+namespace mycraft
+{
+
+// How blocks interact with light, by block id. By default air is
+// transparent, every other block opaque, and nothing emits light.
+struct LightProperties
+{
+	std::array<bool, 256> transparent
+	{ };
+	std::array<std::uint8_t, 256> emission
+	{ };
+
+	LightProperties()
+	{
+		transparent[0] = true;
+	}
+
+	// non-opaque blocks are transparent
+	explicit LightProperties(const BlockRegistry &registry)
+	{
+		for (size_t id = 0; id < transparent.size(); id++)
+		{
+			transparent[id] = !registry[id].opaque();
+			emission[id] = registry[id].emission;
+		}
+	}
+};
+
+// Sky and block light over the chunks of a World (stored in each
+// Chunk::light()), kept up to date by breadth-first flood fills that
+// cross chunk borders.
+//
+// Skylight falls straight down at full strength and loses one level per
+// block otherwise; block light spreads from emitting blocks, one level
+// less per block. Chunks that are not stored are not written; one above
+// a chunk reads as open sky (the world leaves all-air sections
+// unallocated), on other sides as dark, so that unloaded chunks don't
+// light caves. Chunks are lit by light_chunk() once they are stored.
+//
+// Lighting a chunk or changing its light marks it changed(), so that it
+// and, through their borders, its neighbours re-mesh.
+class LightEngine
+{
+public:
+	explicit LightEngine(World &world, LightProperties properties =
+			LightProperties());
+
+	const LightProperties& properties() const
+	{
+		return properties_;
+	}
+
+	// Lights the chunk at c from scratch: skylight from above, its
+	// emitters and the light of its lit neighbours, which its own light
+	// spreads on into. Runs propagate().
+	void light_chunk(const ChunkCoord &c);
+
+	// Queues the light updates for a block whose id was old_id and is now
+	// what the world holds: only the light volume it affected or now
+	// affects is visited. Blocks of unlit chunks are ignored.
+	void block_changed(std::int64_t x, std::int64_t y, std::int64_t z,
+			block_id_t old_id);
+
+	// Runs the queued removals, then the queued additions.
+	void propagate();
+
+	// Chunks whose light changed since the last call and where, in
+	// chunk-local coordinates.
+	std::vector<std::pair<ChunkCoord, DirtyRegion>> take_relit();
+
+	// 0 in chunks that are not stored or not lit.
+	std::uint8_t light(LightChannel channel, std::int64_t x, std::int64_t y,
+			std::int64_t z) const;
+
+	// blocks visited by the flood fills so far
+	std::uint64_t visited() const
+	{
+		return visited_;
+	}
+
+private:
+	struct Node
+	{
+		std::int64_t x, y, z;
+		std::uint8_t level;
+	};
+
+	// a block position resolved to its chunk
+	struct Cell
+	{
+		Chunk *chunk; // nullptr if not stored
+		ChunkCoord coord;
+		CoordElem local[3];
+		size_t index;
+	};
+
+	struct Queues
+	{
+		std::vector<Node> add, remove;
+	};
+
+	Cell locate(std::int64_t x, std::int64_t y, std::int64_t z);
+	void set_level(Cell &cell, LightChannel channel, std::uint8_t level);
+	void queue_neighbours(const Node &at, LightChannel channel);
+	void run_removals(LightChannel channel);
+	void run_additions(LightChannel channel);
+
+	Queues& queues(LightChannel channel)
+	{
+		return queues_[channel == LightChannel::SKY ? 0 : 1];
+	}
+
+	World &world_;
+	LightProperties properties_;
+	std::array<Queues, 2> queues_;
+	// keyed by pack_chunk_coord
+	std::unordered_map<std::uint64_t, DirtyRegion> relit_;
+	// the chunk of the previous locate(); flood fills mostly stay in one
+	std::uint64_t last_key_ = 0;
+	Chunk *last_ = nullptr;
+	bool last_valid_ = false;
+	std::uint64_t visited_ = 0;
+};
+
+}
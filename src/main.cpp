@@ -9,33 +9,34 @@
 #include "worldgen.h"
 #include "world.h"
 #include "TextureMap.h"
+#include <cstring>
 
 using namespace mycraft;
 
 int main(int argc, char **argv)
 {
-	//WorldGenerator gen;
-	//const auto& chunk = gen.generate_chunk(0, 0, 0);
-
-	std::array<Block, Chunk::chunk_length*Chunk::chunk_length*Chunk::chunk_height> blks;
-	for (int i=0; i<Chunk::chunk_length; i++)
-		for (int j=0; j<Chunk::chunk_length; j++)
-			for (int k=0; k<Chunk::chunk_height; k++) {
-				int id = k == Chunk::chunk_height-1 ? 2 : 1;
-				blks[Chunk::convert_index(i, j, k)].set_block_id(id);
-			}
-	auto chunk = std::make_shared<Chunk>(blks);
+	// chunks are streamed in around the player: loaded from the region
+	// files if they were saved before, generated otherwise
+	auto gen = std::make_shared<const WorldGenerator>();
+	auto world = std::make_shared<World>();
 
 	auto sts = std::make_shared<TextureStorage>(standard_texture_storage());
 
-	auto world = std::make_shared<World>();
-	world->set_chunk({0, 0, 0}, chunk);
-	world->set_chunk({1, 0, 0}, chunk2);
-
 	Renderer renderer(800, 600, "MyCraft");
 
 	renderer.set_texture_storage(std::move(sts));
 	renderer.set_world(std::move(world));
+	renderer.set_world_generator(std::move(gen));
+	renderer.set_region_store(std::make_shared<RegionStore>("world"));
+	for (int i = 1; i < argc; i++)
+	{
+		// --profile timings.json (or .csv): time every frame, dump on exit
+		if (!std::strcmp(argv[i], "--profile") && i + 1 < argc)
+			renderer.set_profile_output(argv[++i]);
+		// one draw call per chunk instead of a single multi-draw
+		else if (!std::strcmp(argv[i], "--per-chunk-draws"))
+			renderer.set_multi_draw(false);
+	}
 	renderer.render_loop();
 
 	return 0;
@@ -0,0 +1,161 @@
+#include "mesh_buffer.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace mycraft;
+
+MeshPool& MeshPool::shared()
+{
+	static MeshPool pool;
+	return pool;
+}
+
+MeshVertex* MeshPool::take(Slab &slab,
+		std::map<std::size_t, std::size_t>::iterator range, std::size_t count)
+{
+	const std::size_t offset = range->first, length = range->second;
+	// the rest of the range stays free
+	if (length > count)
+		slab.free.emplace_hint(std::next(range), offset + count,
+				length - count);
+	slab.free.erase(range);
+	if (slab.live == 0)
+		idle_slabs_--;
+	slab.live += count;
+	return slab.vertices.get() + offset;
+}
+
+MeshVertex* MeshPool::allocate(std::size_t count)
+{
+	if (count == 0)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	vertices_in_use_ += count;
+
+	// first fit, lowest address first, so that the last slabs drain
+	for (auto &s : slabs_)
+		for (auto it = s.second.free.begin(); it != s.second.free.end(); ++it)
+			if (it->second >= count)
+				return take(s.second, it, count);
+
+	Slab slab;
+	slab.size = std::max(count, slab_vertices);
+	slab.vertices.reset(new MeshVertex[slab.size]);
+	slab.free.emplace(0, slab.size);
+	vertices_reserved_ += slab.size;
+	idle_slabs_++;
+	const MeshVertex *start = slab.vertices.get();
+	Slab &added = slabs_.emplace(start, std::move(slab)).first->second;
+	return take(added, added.free.begin(), count);
+}
+
+void MeshPool::deallocate(MeshVertex *p, std::size_t count)
+{
+	if (!p)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	vertices_in_use_ -= count;
+
+	auto it = std::prev(slabs_.upper_bound(p));
+	Slab &slab = it->second;
+	std::size_t offset = p - slab.vertices.get();
+	std::size_t length = count;
+	// merge with the free ranges on either side
+	auto next = slab.free.lower_bound(offset);
+	if (next != slab.free.end() && next->first == offset + length)
+	{
+		length += next->second;
+		next = slab.free.erase(next);
+	}
+	if (next != slab.free.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			length += prev->second;
+			slab.free.erase(prev);
+		}
+	}
+	slab.free.emplace(offset, length);
+
+	slab.live -= count;
+	if (slab.live > 0)
+		return;
+	// keep one idle slab of the usual size for the next meshes
+	if (idle_slabs_ == 0 && slab.size == slab_vertices)
+	{
+		idle_slabs_++;
+		return;
+	}
+	vertices_reserved_ -= slab.size;
+	slabs_.erase(it);
+}
+
+std::size_t MeshPool::bytes_in_use() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return vertices_in_use_ * sizeof(MeshVertex);
+}
+
+std::size_t MeshPool::bytes_reserved() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return vertices_reserved_ * sizeof(MeshVertex);
+}
+
+std::size_t MeshPool::bytes_free() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (vertices_reserved_ - vertices_in_use_) * sizeof(MeshVertex);
+}
+
+MeshBuffer::MeshBuffer(std::size_t count, MeshPool &pool) :
+		pool_(&pool), data_(pool.allocate(count)), size_(count)
+{
+}
+
+MeshBuffer::MeshBuffer(MeshBuffer &&other) noexcept :
+		pool_(other.pool_), data_(other.data_), size_(other.size_)
+{
+	other.data_ = nullptr;
+	other.size_ = 0;
+}
+
+MeshBuffer::~MeshBuffer()
+{
+	release();
+}
+
+MeshBuffer& MeshBuffer::operator=(MeshBuffer &&other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		pool_ = other.pool_;
+		data_ = other.data_;
+		size_ = other.size_;
+		other.data_ = nullptr;
+		other.size_ = 0;
+	}
+	return *this;
+}
+
+MeshBuffer MeshBuffer::copy_of(const MeshVertex *vertices, std::size_t count,
+		MeshPool &pool)
+{
+	MeshBuffer buffer(count, pool);
+	std::copy(vertices, vertices + count, buffer.data());
+	return buffer;
+}
+
+void MeshBuffer::release()
+{
+	if (pool_)
+		pool_->deallocate(data_, size_);
+	data_ = nullptr;
+	size_ = 0;
+}
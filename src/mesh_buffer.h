@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "mesher.h"
+
+namespace mycraft
+{
+
+// Arena for chunk mesh storage. Buffers of exactly the requested vertex
+// count are carved out of large slabs, first fit in address order; a
+// freed buffer is merged with the free ranges next to it, so holes do not
+// pile up as meshes change size. A slab with no live buffers is returned
+// to the system, except for one kept for the next meshes. Rebuilding a
+// chunk does not go through the general-purpose heap. Thread-safe.
+class MeshPool
+{
+public:
+	MeshPool() = default;
+	MeshPool(const MeshPool&) = delete;
+	MeshPool& operator=(const MeshPool&) = delete;
+
+	// pool used by ChunkCache and MeshWorkerPool.
+	static MeshPool& shared();
+
+	MeshVertex* allocate(std::size_t count);
+	void deallocate(MeshVertex *p, std::size_t count);
+
+	// bytes held by live MeshBuffers.
+	std::size_t bytes_in_use() const;
+	// bytes obtained from the system.
+	std::size_t bytes_reserved() const;
+	// bytes reserved but held by no MeshBuffer: the holes between buffers
+	// and the unused ends of slabs.
+	std::size_t bytes_free() const;
+
+private:
+	// room for the largest chunk mesh; larger requests get a slab of
+	// their own size
+	static constexpr std::size_t slab_vertices = 64 * 1024;
+	static_assert(slab_vertices >= max_chunk_vertices,
+			"a chunk mesh must fit in one slab");
+
+	struct Slab
+	{
+		std::unique_ptr<MeshVertex[]> vertices;
+		std::size_t size;
+		// free ranges: offset -> vertex count, never adjacent
+		std::map<std::size_t, std::size_t> free;
+		std::size_t live = 0;
+	};
+
+	// the first count vertices of the free range of slab
+	MeshVertex* take(Slab &slab,
+			std::map<std::size_t, std::size_t>::iterator range,
+			std::size_t count);
+
+	mutable std::mutex mutex_;
+	// by start address, to find the slab of a freed pointer
+	std::map<const MeshVertex*, Slab> slabs_;
+	// slabs with no live buffers (at most one)
+	std::size_t idle_slabs_ = 0;
+	std::size_t vertices_in_use_ = 0;
+	std::size_t vertices_reserved_ = 0;
+};
+
+// Exactly-sized, move-only mesh storage taken from a MeshPool.
+class MeshBuffer
+{
+public:
+	MeshBuffer() = default;
+	MeshBuffer(std::size_t count, MeshPool &pool = MeshPool::shared());
+	MeshBuffer(const MeshBuffer&) = delete;
+	MeshBuffer(MeshBuffer &&other) noexcept;
+	~MeshBuffer();
+
+	MeshBuffer& operator=(const MeshBuffer&) = delete;
+	MeshBuffer& operator=(MeshBuffer &&other) noexcept;
+
+	static MeshBuffer copy_of(const MeshVertex *vertices, std::size_t count,
+			MeshPool &pool = MeshPool::shared());
+
+	MeshVertex* data()
+	{
+		return data_;
+	}
+	const MeshVertex* data() const
+	{
+		return data_;
+	}
+	std::size_t size() const
+	{
+		return size_;
+	}
+	std::size_t bytes() const
+	{
+		return size_ * sizeof(MeshVertex);
+	}
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+private:
+	MeshPool *pool_ = nullptr;
+	MeshVertex *data_ = nullptr;
+	std::size_t size_ = 0;
+
+	void release();
+};
+
+}
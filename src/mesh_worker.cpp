@@ -0,0 +1,121 @@
+#include "mesh_worker.h"
+
+using namespace mycraft;
+
+MeshCompletionQueue::~MeshCompletionQueue()
+{
+	while (pop())
+		;
+}
+
+void MeshCompletionQueue::push(std::unique_ptr<MeshResult> result)
+{
+	MeshResult *node = result.release();
+	node->next = incoming_.load(std::memory_order_relaxed);
+	while (!incoming_.compare_exchange_weak(node->next, node,
+			std::memory_order_release, std::memory_order_relaxed))
+		;
+}
+
+std::unique_ptr<MeshResult> MeshCompletionQueue::pop()
+{
+	if (!outgoing_)
+	{
+		// grab everything pushed so far (newest first) and reverse it
+		MeshResult *node = incoming_.exchange(nullptr,
+				std::memory_order_acquire);
+		while (node)
+		{
+			MeshResult *next = node->next;
+			node->next = outgoing_;
+			outgoing_ = node;
+			node = next;
+		}
+	}
+
+	MeshResult *front = outgoing_;
+	if (front)
+	{
+		outgoing_ = front->next;
+		front->next = nullptr;
+	}
+	return std::unique_ptr<MeshResult>(front);
+}
+
+MeshWorkerPool::MeshWorkerPool(std::shared_ptr<const BlockRegistry> registry,
+		unsigned threads) :
+		registry_(std::move(registry))
+{
+	if (threads == 0)
+	{
+		const unsigned hw = std::thread::hardware_concurrency();
+		threads = hw > 1 ? hw - 1 : 1;
+	}
+
+	workers_.reserve(threads);
+	for (unsigned i = 0; i < threads; i++)
+		workers_.emplace_back(&MeshWorkerPool::worker_main, this);
+}
+
+MeshWorkerPool::~MeshWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex_);
+		stopping_ = true;
+	}
+	jobs_cv_.notify_all();
+	for (auto &worker : workers_)
+		worker.join();
+}
+
+void MeshWorkerPool::submit(const ChunkCoord &coord, std::uint64_t ticket,
+		const Chunk &chunk, const ChunkBorders &borders, MeshingMode mode)
+{
+	Job job
+	{ coord, ticket, mode, std::make_unique<const Chunk>(chunk),
+			std::make_unique<const ChunkBorders>(borders) };
+	in_flight_.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(jobs_mutex_);
+		jobs_.push_back(std::move(job));
+	}
+	jobs_cv_.notify_one();
+}
+
+std::unique_ptr<MeshResult> MeshWorkerPool::poll()
+{
+	auto result = completed_.pop();
+	if (result)
+		in_flight_.fetch_sub(1, std::memory_order_relaxed);
+	return result;
+}
+
+void MeshWorkerPool::worker_main()
+{
+	// worst-case scratch buffer, reused for every job on this thread
+	std::vector<MeshVertex> scratch(max_chunk_vertices);
+
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobs_mutex_);
+			jobs_cv_.wait(lock, [this]
+			{	return stopping_ || !jobs_.empty();});
+			if (stopping_)
+				return;
+			job = std::move(jobs_.front());
+			jobs_.pop_front();
+		}
+
+		const size_t count = mesh_chunk(*job.snapshot, *registry_, job.mode,
+				scratch.data(), job.borders.get());
+
+		auto result = std::make_unique<MeshResult>();
+		result->coord = job.coord;
+		result->ticket = job.ticket;
+		result->vertices = MeshBuffer::copy_of(scratch.data(), count);
+
+		completed_.push(std::move(result));
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mesher.h"
+#include "mesh_buffer.h"
+#include "world.h"
+#include "TextureMap.h"
+
+namespace mycraft
+{
+
+// A finished chunk mesh, handed from a worker to the render thread.
+struct MeshResult
+{
+	ChunkCoord coord;
+	std::uint64_t ticket;
+	MeshBuffer vertices;
+
+	MeshResult *next = nullptr; // intrusive link for MeshCompletionQueue
+};
+
+// Lock-free multi-producer, single-consumer FIFO of MeshResults.
+// Producers push with a CAS on the shared head; the consumer takes the
+// whole list at once and reverses it into a private FIFO, so it never
+// contends with producers element by element.
+class MeshCompletionQueue
+{
+public:
+	MeshCompletionQueue() = default;
+	MeshCompletionQueue(const MeshCompletionQueue&) = delete;
+	MeshCompletionQueue& operator=(const MeshCompletionQueue&) = delete;
+	~MeshCompletionQueue();
+
+	// may be called from any thread.
+	void push(std::unique_ptr<MeshResult> result);
+
+	// consumer thread only. Returns nullptr if the queue is empty.
+	std::unique_ptr<MeshResult> pop();
+
+private:
+	std::atomic<MeshResult*> incoming_ { nullptr };
+	MeshResult *outgoing_ = nullptr; // owned by the consumer
+};
+
+// Builds chunk meshes on background threads. Jobs carry their own copy of
+// the chunk (compact chunks stay compact until the worker expands its
+// copy), so workers never touch the live World.
+class MeshWorkerPool
+{
+public:
+	// threads == 0 picks one less than the number of hardware threads.
+	MeshWorkerPool(std::shared_ptr<const BlockRegistry> registry,
+			unsigned threads = 0);
+	MeshWorkerPool(const MeshWorkerPool&) = delete;
+	MeshWorkerPool& operator=(const MeshWorkerPool&) = delete;
+	~MeshWorkerPool();
+
+	// Snapshots chunk and the border layers of its neighbours and queues
+	// them for meshing. The result comes back from poll() with the same
+	// coord and ticket.
+	void submit(const ChunkCoord &coord, std::uint64_t ticket,
+			const Chunk &chunk, const ChunkBorders &borders, MeshingMode mode);
+
+	// Returns the next finished mesh, or nullptr if none is ready.
+	// Must always be called from the same thread.
+	std::unique_ptr<MeshResult> poll();
+
+	// Number of submitted jobs whose result has not been polled yet.
+	size_t in_flight() const
+	{
+		return in_flight_.load(std::memory_order_relaxed);
+	}
+
+	size_t threads() const
+	{
+		return workers_.size();
+	}
+
+private:
+	struct Job
+	{
+		ChunkCoord coord;
+		std::uint64_t ticket;
+		MeshingMode mode;
+		std::unique_ptr<const Chunk> snapshot;
+		std::unique_ptr<const ChunkBorders> borders;
+	};
+
+	std::shared_ptr<const BlockRegistry> registry_;
+	std::vector<std::thread> workers_;
+
+	std::mutex jobs_mutex_;
+	std::condition_variable jobs_cv_;
+	std::deque<Job> jobs_;
+	bool stopping_ = false;
+
+	MeshCompletionQueue completed_;
+	std::atomic<size_t> in_flight_ { 0 };
+
+	void worker_main();
+};
+
+}
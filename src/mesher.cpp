@@ -0,0 +1,511 @@
+#include "mesher.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr int chunk_dims[3] =
+{ Chunk::chunk_length, Chunk::chunk_length, Chunk::chunk_height };
+
+// Describes one of the six face directions. A quad lies in the plane
+// perpendicular to n_axis and is spanned by u_axis (texture u) and
+// v_axis (texture v).
+struct FaceDesc
+{
+	TexDir tex_dir;
+	int n_axis;
+	bool n_positive;
+	int u_axis;
+	bool u_positive;
+	int v_axis;
+	bool swap_winding;
+};
+
+// Same order as the faces were originally emitted per block.
+constexpr FaceDesc faces[6] =
+{
+{ TEX_YNEG, 1, false, 0, true, 2, false },
+{ TEX_XPOS, 0, true, 1, true, 2, false },
+{ TEX_YPOS, 1, true, 0, false, 2, false },
+{ TEX_XNEG, 0, false, 1, false, 2, false },
+{ TEX_ZNEG, 2, false, 0, true, 1, true },
+{ TEX_ZPOS, 2, true, 0, true, 1, false } };
+
+// (u, v) corners of a quad, in the order quad_indices() turns into two
+// clockwise triangles.
+constexpr int corners[4][2] =
+{
+{ 0, 0 },
+{ 0, 1 },
+{ 1, 1 },
+{ 1, 0 } };
+constexpr int corners_swapped[4][2] =
+{
+{ 0, 0 },
+{ 1, 0 },
+{ 1, 1 },
+{ 0, 1 } };
+
+constexpr MeshIndex quad_index_pattern[quad_indices_per_quad] =
+{ 0, 1, 2, 2, 3, 0 };
+
+block_id_t block_at(const Chunk::ChunkData &blocks, const int (&pos)[3])
+{
+	return blocks[Chunk::convert_index(pos[0], pos[1], pos[2])].block_id();
+}
+
+// The two axes other than axis, in x, y, z order.
+constexpr int other_axes[3][2] =
+{
+{ 1, 2 },
+{ 0, 2 },
+{ 0, 1 } };
+
+// BlockInfo::flags of the blocks of the chunk being meshed and of the
+// layer of neighbour blocks around it, looked up once, so that the
+// visibility checks read a local array without bounds checks. Without
+// borders (and on the unused edges) the layer is air. Block ids are only
+// needed between two blocks that are not opaque, and are read from the
+// chunk and the borders then. The same flags are also kept as bit columns
+// along z, for checks a column at a time.
+class PaddedFlags
+{
+public:
+	// the chunk and the layer around it
+	static constexpr int sx = chunk_dims[0] + 2, sy = chunk_dims[1] + 2,
+			sz = chunk_dims[2] + 2;
+	static_assert(sz <= 32, "a column along z must fit in 32 bits");
+	// steps of index() along x, y and z
+	static constexpr int stride[3] =
+	{ sy * sz, sz, 1 };
+
+	PaddedFlags(const Chunk::ChunkData &blocks, const ChunkBorders *borders,
+			const BlockRegistry &reg) :
+			blocks_(blocks), borders_(borders)
+	{
+		flags_.fill(BlockInfo::AIR);
+		filled_.fill(0);
+		opaque_.fill(0);
+		int pos[3];
+		pos[2] = 0;
+		// z runs fastest in both layouts: a column at a time
+		for (pos[0] = 0; pos[0] < chunk_dims[0]; pos[0]++)
+			for (pos[1] = 0; pos[1] < chunk_dims[1]; pos[1]++)
+			{
+				std::uint8_t *column = &flags_[index(pos)];
+				const Block *source = &blocks[Chunk::convert_index(pos[0],
+						pos[1], 0)];
+				std::uint32_t filled = 0, opaque = 0;
+				for (int z = 0; z < chunk_dims[2]; z++)
+				{
+					const std::uint8_t flags = reg[source[z].block_id()].flags;
+					column[z] = flags;
+					filled |= std::uint32_t(!(flags & BlockInfo::AIR)) << z;
+					opaque |= std::uint32_t(!!(flags & BlockInfo::OPAQUE)) << z;
+				}
+				filled_[column_index(pos[0], pos[1])] = filled << 1;
+				opaque_[column_index(pos[0], pos[1])] = opaque << 1;
+			}
+		if (borders)
+			fill_borders(*borders, reg);
+	}
+
+	// Bit z + 1 is block z of column (x, y), which may be one block
+	// outside the chunk; bits 0 and chunk_dims[2] + 1 are the blocks
+	// below and above the chunk.
+	std::uint32_t filled(int x, int y) const
+	{
+		return filled_[column_index(x, y)];
+	}
+
+	std::uint32_t opaque(int x, int y) const
+	{
+		return opaque_[column_index(x, y)];
+	}
+
+	// pos may be one block outside the chunk
+	static int index(const int (&pos)[3])
+	{
+		return ((pos[0] + 1) * sy + pos[1] + 1) * sz + pos[2] + 1;
+	}
+
+	std::uint8_t operator[](int index) const
+	{
+		return flags_[index];
+	}
+
+	std::uint8_t operator[](const int (&pos)[3]) const
+	{
+		return flags_[index(pos)];
+	}
+
+	// pos may be one block outside the chunk across one face
+	block_id_t id(const int (&pos)[3]) const
+	{
+		for (const auto &f : faces)
+		{
+			const int outside = f.n_positive ? chunk_dims[f.n_axis] : -1;
+			if (pos[f.n_axis] != outside)
+				continue;
+			if (!borders_)
+				return 0;
+			const auto &axes = other_axes[f.n_axis];
+			return borders_->slices[f.tex_dir][pos[axes[0]]
+					* ChunkBorders::side + pos[axes[1]]];
+		}
+		return block_at(blocks_, pos);
+	}
+
+private:
+	static int column_index(int x, int y)
+	{
+		return (x + 1) * sy + y + 1;
+	}
+
+	void fill_borders(const ChunkBorders &borders, const BlockRegistry &reg)
+	{
+		int pos[3];
+		for (const auto &f : faces)
+		{
+			const auto &axes = other_axes[f.n_axis];
+			pos[f.n_axis] = f.n_positive ? chunk_dims[f.n_axis] : -1;
+			for (int a = 0; a < chunk_dims[axes[0]]; a++)
+				for (int b = 0; b < chunk_dims[axes[1]]; b++)
+				{
+					pos[axes[0]] = a;
+					pos[axes[1]] = b;
+					const std::uint8_t flags = reg[borders.slices[f.tex_dir][a
+							* ChunkBorders::side + b]].flags;
+					flags_[index(pos)] = flags;
+					const int c = column_index(pos[0], pos[1]);
+					filled_[c] |= std::uint32_t(!(flags & BlockInfo::AIR))
+							<< (pos[2] + 1);
+					opaque_[c] |= std::uint32_t(!!(flags & BlockInfo::OPAQUE))
+							<< (pos[2] + 1);
+				}
+		}
+	}
+
+	const Chunk::ChunkData &blocks_;
+	const ChunkBorders *borders_;
+	std::array<std::uint8_t, sx * sy * sz> flags_;
+	std::array<std::uint32_t, sx * sy> filled_, opaque_;
+};
+
+// true if the face of the block at pos (index i of PaddedFlags) facing f
+// is not covered by an opaque block. Between two blocks that are not
+// opaque only the face of the one with the higher id is kept (none
+// between blocks of the same id), so that there is never more than one
+// face per pair of neighbouring blocks (max_chunk_quads).
+bool face_visible(const PaddedFlags &flags, const FaceDesc &f,
+		const int (&pos)[3], int i)
+{
+	const int step = PaddedFlags::stride[f.n_axis];
+	const auto covering = flags[f.n_positive ? i + step : i - step];
+	if (covering & BlockInfo::OPAQUE)
+		return false;
+	if ((covering & BlockInfo::AIR) || (flags[i] & BlockInfo::OPAQUE))
+		return true;
+	int n[3] =
+	{ pos[0], pos[1], pos[2] };
+	n[f.n_axis] += f.n_positive ? 1 : -1;
+	return flags.id(n) < flags.id(pos);
+}
+
+// Light level of the face of the block at pos facing f: that of the
+// block in front of it.
+int face_light(const ChunkLight *light, const ChunkBorders *borders,
+		const FaceDesc &f, const int (&pos)[3])
+{
+	if (!light)
+		return ChunkLight::max_level;
+	int n[3] =
+	{ pos[0], pos[1], pos[2] };
+	n[f.n_axis] += f.n_positive ? 1 : -1;
+	if (n[f.n_axis] < 0 || n[f.n_axis] >= chunk_dims[f.n_axis])
+	{
+		if (!borders)
+			return ChunkLight::max_level;
+		const auto &axes = other_axes[f.n_axis];
+		return borders->light[f.tex_dir][pos[axes[0]] * ChunkBorders::side
+				+ pos[axes[1]]];
+	}
+	return light->level(Chunk::convert_index(n[0], n[1], n[2]));
+}
+
+// Emits a quad of w x h blocks whose lowest corner (in positive axis
+// directions) within the layer is (p0, q0).
+std::size_t emit_quad(MeshVertex *out, std::size_t a, const FaceDesc &f,
+		int layer, int p0, int q0, int w, int h, std::uint8_t tile, int light)
+{
+	const auto &order = f.swap_winding ? corners_swapped : corners;
+	for (const auto &c : order)
+	{
+		int pos[3];
+		pos[f.n_axis] = layer + (f.n_positive ? 1 : 0);
+		pos[f.u_axis] = f.u_positive ? p0 + c[0] * w : p0 + w - c[0] * w;
+		pos[f.v_axis] = q0 + c[1] * h;
+		out[a++] = pack_vertex(pos[0], pos[1], pos[2], f.tex_dir, tile & 15,
+				tile >> 4, light);
+	}
+	return a;
+}
+
+std::size_t mesh_per_face(const Chunk::ChunkData &blocks,
+		const PaddedFlags &flags, const ChunkLight *light,
+		const ChunkBorders *borders, const BlockRegistry &reg, MeshVertex *out)
+{
+	std::size_t a = 0;
+	for (int i = 0; i < Chunk::chunk_length; i++)
+	{
+		for (int j = 0; j < Chunk::chunk_length; j++)
+		{
+			for (int k = 0; k < Chunk::chunk_height; k++)
+			{
+				const int pos[3] =
+				{ i, j, k };
+				const int index = PaddedFlags::index(pos);
+				if (flags[index] & BlockInfo::AIR)
+					continue;
+				const auto &info = reg[block_at(blocks, pos)];
+
+				for (const auto &f : faces)
+				{
+					if (!face_visible(flags, f, pos, index))
+						continue;
+					a = emit_quad(out, a, f, pos[f.n_axis], pos[f.u_axis],
+							pos[f.v_axis], 1, 1, info.tiles[f.tex_dir],
+							face_light(light, borders, f, pos));
+				}
+			}
+		}
+	}
+	return a;
+}
+
+std::size_t mesh_greedy(const Chunk::ChunkData &blocks,
+		const PaddedFlags &flags, const ChunkLight *light,
+		const ChunkBorders *borders, const BlockRegistry &reg, MeshVertex *out)
+{
+	constexpr int max_dim = Chunk::chunk_length > Chunk::chunk_height ?
+			Chunk::chunk_length : Chunk::chunk_height;
+	constexpr int no_face = -1;
+
+	// The visible faces of each column along z, bit z for block z, by
+	// faces[] entry and x * chunk_dims[1] + y, worked out a column at a
+	// time with the checks of face_visible(): a face is kept against an
+	// air block, and against a block that is not opaque if it is opaque
+	// itself. Only faces between two blocks that are not opaque need the
+	// block ids. used_layers[d] has bit l set if layer l of faces[d] has a
+	// visible face; the others are skipped.
+	constexpr std::uint32_t inside = ((1u << chunk_dims[2]) - 1) << 1;
+	std::uint16_t visible[6][chunk_dims[0] * chunk_dims[1]];
+	std::uint32_t used_layers[6] = {};
+	for (int x = 0; x < chunk_dims[0]; x++)
+		for (int y = 0; y < chunk_dims[1]; y++)
+		{
+			const std::uint32_t filled = flags.filled(x, y) & inside;
+			const std::uint32_t opaque = flags.opaque(x, y) & inside;
+			for (int d = 0; d < 6; d++)
+			{
+				const auto &f = faces[d];
+				const int step = f.n_positive ? 1 : -1;
+				std::uint32_t n_filled, n_opaque;
+				if (f.n_axis == 2)
+				{
+					n_filled = step > 0 ? flags.filled(x, y) >> 1 :
+							flags.filled(x, y) << 1;
+					n_opaque = step > 0 ? flags.opaque(x, y) >> 1 :
+							flags.opaque(x, y) << 1;
+				}
+				else
+				{
+					const int nx = x + (f.n_axis == 0 ? step : 0);
+					const int ny = y + (f.n_axis == 1 ? step : 0);
+					n_filled = flags.filled(nx, ny);
+					n_opaque = flags.opaque(nx, ny);
+				}
+				std::uint32_t bits = filled & ~n_opaque & (~n_filled | opaque);
+				for (std::uint32_t both = filled & ~opaque & n_filled
+						& ~n_opaque; both; both &= both - 1)
+				{
+					const int pos[3] =
+					{ x, y, __builtin_ctz(both) - 1 };
+					if (face_visible(flags, f, pos, PaddedFlags::index(pos)))
+						bits |= both & -both;
+				}
+				const std::uint16_t column = bits >> 1;
+				visible[d][x * chunk_dims[1] + y] = column;
+				if (column)
+					used_layers[d] |= f.n_axis == 2 ?
+							column : 1u << (f.n_axis == 0 ? x : y);
+			}
+		}
+
+	// mask[p][q] holds the packed tile and light of the visible face at
+	// (p, q) in the current layer, or no_face: only faces that look the
+	// same are merged.
+	int mask[max_dim][max_dim];
+	std::size_t a = 0;
+
+	for (int d = 0; d < 6; d++)
+	{
+		const auto &f = faces[d];
+		const int layers = chunk_dims[f.n_axis];
+		const int pn = chunk_dims[f.u_axis];
+		const int qn = chunk_dims[f.v_axis];
+
+		for (int layer = 0; layer < layers; layer++)
+		{
+			if (!(used_layers[d] >> layer & 1))
+				continue;
+			int pos[3];
+			pos[f.n_axis] = layer;
+			// bit q set if some (p, q) of the mask has a face
+			std::uint32_t used_q = 0;
+			for (int p = 0; p < pn; p++)
+			{
+				pos[f.u_axis] = p;
+				std::fill_n(mask[p], qn, no_face);
+				// the visible faces (p, q) of this row, bit q
+				std::uint32_t row = 0;
+				if (f.v_axis == 2)
+					row = visible[d][pos[0] * chunk_dims[1] + pos[1]];
+				else
+					for (int q = 0; q < qn; q++)
+					{
+						pos[f.v_axis] = q;
+						row |= (visible[d][pos[0] * chunk_dims[1] + pos[1]]
+								>> pos[2] & 1u) << q;
+					}
+				used_q |= row;
+				for (; row; row &= row - 1)
+				{
+					const int q = __builtin_ctz(row);
+					pos[f.v_axis] = q;
+					mask[p][q] = reg[block_at(blocks, pos)].tiles[f.tex_dir]
+							| face_light(light, borders, f, pos) << 8;
+				}
+			}
+
+			for (int q = 0; q < qn; q++)
+			{
+				if (!(used_q >> q & 1))
+					continue;
+				for (int p = 0; p < pn;)
+				{
+					const int key = mask[p][q];
+					if (key == no_face)
+					{
+						p++;
+						continue;
+					}
+
+					int w = 1;
+					while (p + w < pn && mask[p + w][q] == key)
+						w++;
+
+					int h = 1;
+					for (; q + h < qn; h++)
+					{
+						bool row_matches = true;
+						for (int dp = 0; dp < w; dp++)
+						{
+							if (mask[p + dp][q + h] != key)
+							{
+								row_matches = false;
+								break;
+							}
+						}
+						if (!row_matches)
+							break;
+					}
+
+					for (int dq = 0; dq < h; dq++)
+						for (int dp = 0; dp < w; dp++)
+							mask[p + dp][q + dq] = no_face;
+
+					a = emit_quad(out, a, f, layer, p, q, w, h,
+							(std::uint8_t) (key & 0xff), key >> 8);
+					p += w;
+				}
+			}
+		}
+	}
+	return a;
+}
+
+}
+
+std::vector<MeshIndex> mycraft::quad_indices(std::size_t quads)
+{
+	std::vector<MeshIndex> indices;
+	indices.reserve(quads * quad_indices_per_quad);
+	for (std::size_t q = 0; q < quads; q++)
+		for (const auto i : quad_index_pattern)
+			indices.push_back((MeshIndex) (q * quad_vertices + i));
+	return indices;
+}
+
+ChunkBorders mycraft::chunk_borders(const World &world,
+		const ChunkCoord &coord)
+{
+	ChunkBorders borders;
+	for (const auto &f : faces)
+	{
+		CoordElem nc[3] =
+		{ coord.x(), coord.y(), coord.z() };
+		nc[f.n_axis] += f.n_positive ? 1 : -1;
+		const Chunk *neighbour = world.find_chunk(
+				ChunkCoord(nc[0], nc[1], nc[2]));
+		if (!neighbour)
+			continue;
+		const ChunkLight *light = neighbour->light();
+
+		// the neighbour's layer on the side facing this chunk
+		// (block_id() reads compact neighbours without expanding them)
+		const auto &axes = other_axes[f.n_axis];
+		auto &slice = borders.slices[f.tex_dir];
+		int pos[3];
+		pos[f.n_axis] = f.n_positive ? 0 : chunk_dims[f.n_axis] - 1;
+		for (int a = 0; a < chunk_dims[axes[0]]; a++)
+			for (int b = 0; b < chunk_dims[axes[1]]; b++)
+			{
+				pos[axes[0]] = a;
+				pos[axes[1]] = b;
+				slice[a * ChunkBorders::side + b] = neighbour->block_id(pos[0],
+						pos[1], pos[2]);
+				borders.light[f.tex_dir][a * ChunkBorders::side + b] =
+						light ? light->level(Chunk::convert_index(pos[0],
+								pos[1], pos[2])) : 0;
+			}
+	}
+	return borders;
+}
+
+std::size_t mycraft::mesh_chunk(const Chunk &chunk,
+		const BlockRegistry &registry,
+		MeshingMode mode, MeshVertex *out, const ChunkBorders *borders)
+{
+	const auto &blocks = chunk.data();
+	const PaddedFlags flags(blocks, borders, registry);
+	std::size_t vertices;
+	switch (mode)
+	{
+	case MeshingMode::GREEDY:
+		vertices = mesh_greedy(blocks, flags, chunk.light(), borders,
+				registry, out);
+		break;
+	case MeshingMode::PER_FACE:
+	default:
+		vertices = mesh_per_face(blocks, flags, chunk.light(), borders,
+				registry, out);
+		break;
+	}
+	assert(vertices <= max_chunk_vertices);
+	return vertices;
+}
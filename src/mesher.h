@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "world.h"
+#include "block_registry.h"
+
+namespace mycraft
+{
+
+enum class MeshingMode
+{
+	PER_FACE, // one quad per visible block face
+	GREEDY    // coplanar faces with the same texture merged into rectangles
+};
+
+// Meshes are indexed quads: 4 vertices per quad, drawn with the shared
+// index pattern of quad_indices(). A vertex is one packed 32-bit
+// attribute:
+//
+//   bits  0-14  corner position x, y, z (5 bits each, 0 .. chunk size)
+//   bits 15-17  face direction (TexDir)
+//   bits 18-25  atlas tile x, y (4 bits each)
+//   bits 26-29  light level of the face (the brighter of sky and block
+//               light in front of it, ChunkLight::max_level if unlit)
+//
+// The shader derives the texture coordinates from the position and the
+// face direction and wraps them into the tile, so that quads merged by
+// the greedy mesher repeat the texture.
+constexpr std::size_t mesh_vertex_attrs = 1;
+using MeshVertex = std::uint32_t;
+using MeshIndex = std::uint16_t;
+
+static_assert(Chunk::chunk_length < 32 && Chunk::chunk_height < 32,
+		"corner positions must fit in 5 bits");
+
+constexpr MeshVertex pack_vertex(int x, int y, int z, int face, int tile_x,
+		int tile_y, int light = ChunkLight::max_level)
+{
+	return (MeshVertex) x | (MeshVertex) y << 5 | (MeshVertex) z << 10
+			| (MeshVertex) face << 15 | (MeshVertex) (tile_x & 15) << 18
+			| (MeshVertex) (tile_y & 15) << 22 | (MeshVertex) (light & 15) << 26;
+}
+
+constexpr int vertex_x(MeshVertex v) { return v & 31; }
+constexpr int vertex_y(MeshVertex v) { return v >> 5 & 31; }
+constexpr int vertex_z(MeshVertex v) { return v >> 10 & 31; }
+constexpr TexDir vertex_face(MeshVertex v) { return (TexDir) (v >> 15 & 7); }
+constexpr int vertex_tile_x(MeshVertex v) { return v >> 18 & 15; }
+constexpr int vertex_tile_y(MeshVertex v) { return v >> 22 & 15; }
+constexpr int vertex_light(MeshVertex v) { return v >> 26 & 15; }
+
+constexpr std::size_t quad_vertices = 4;
+constexpr std::size_t quad_indices_per_quad = 6;
+
+// At most one face per pair of neighbouring blocks inside the chunk (even
+// between blocks that are not opaque, see mesh_chunk()) plus one per block
+// face on its boundary.
+constexpr std::size_t max_chunk_quads =
+		(std::size_t) (Chunk::chunk_length - 1) * Chunk::chunk_length
+				* Chunk::chunk_height * 2
+				+ (std::size_t) Chunk::chunk_length * Chunk::chunk_length
+						* (Chunk::chunk_height - 1)
+				+ (std::size_t) Chunk::chunk_length * Chunk::chunk_height * 4
+				+ (std::size_t) Chunk::chunk_length * Chunk::chunk_length * 2;
+constexpr std::size_t max_chunk_vertices = max_chunk_quads * quad_vertices;
+constexpr std::size_t max_chunk_indices = max_chunk_quads
+		* quad_indices_per_quad;
+
+static_assert(max_chunk_vertices <= 65536,
+		"chunk meshes must be addressable with 16-bit indices");
+
+// The index pattern shared by every mesh: quad q is the clockwise
+// triangles (4q, 4q+1, 4q+2) and (4q+2, 4q+3, 4q).
+std::vector<MeshIndex> quad_indices(std::size_t quads = max_chunk_quads);
+
+// The block layers of the six neighbouring chunks that touch a chunk,
+// indexed by TexDir. slices[dir][a * side + b] is the neighbour block
+// against position (a, b) of that face, where a and b are the two
+// coordinates other than the face normal, in x, y, z order. A missing
+// neighbour is all air, so the faces against it are kept. light holds
+// the light levels of the same blocks (ChunkLight::level()); a missing
+// neighbour is open air at full light, one not lit yet is dark.
+struct ChunkBorders
+{
+	static constexpr int side =
+			Chunk::chunk_length > Chunk::chunk_height ?
+					Chunk::chunk_length : Chunk::chunk_height;
+	using Slice = std::array<block_id_t, side * side>;
+	using LightSlice = std::array<std::uint8_t, side * side>;
+
+	std::array<Slice, 6> slices {};
+	std::array<LightSlice, 6> light;
+
+	ChunkBorders()
+	{
+		for (auto &slice : light)
+			slice.fill(ChunkLight::max_level);
+	}
+
+	bool operator==(const ChunkBorders &other) const
+	{
+		return slices == other.slices && light == other.light;
+	}
+
+	bool operator!=(const ChunkBorders &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Copies the border layers of the neighbours of the chunk at coord.
+ChunkBorders chunk_borders(const World &world, const ChunkCoord &coord);
+
+// Writes the quads of chunk into out (which must have room for
+// max_chunk_vertices) and returns the number of vertices written.
+// Without borders, every face on the chunk boundary is emitted; with
+// them, the ones covered by a neighbouring block are culled. Of two
+// neighbouring blocks that are not opaque, only the one with the higher id
+// keeps the face between them (neither if the ids are equal). Faces take
+// the light of the block in front of them if the chunk is lit (from
+// borders on the chunk boundary).
+std::size_t mesh_chunk(const Chunk &chunk, const BlockRegistry &registry,
+		MeshingMode mode, MeshVertex *out,
+		const ChunkBorders *borders = nullptr);
+
+}
@@ -0,0 +1,63 @@
+#include "page_arena.h"
+
+#include <iterator>
+
+using namespace mycraft;
+
+PageArena::PageArena(std::size_t pages)
+{
+	grow(pages);
+}
+
+std::size_t PageArena::allocate(std::size_t count)
+{
+	if (count == 0)
+		return npos;
+	for (auto it = free_.begin(); it != free_.end(); ++it)
+	{
+		if (it->second < count)
+			continue;
+		const auto first = it->first;
+		if (it->second > count)
+			free_.emplace(first + count, it->second - count);
+		free_.erase(it);
+		in_use_ += count;
+		return first;
+	}
+	return npos;
+}
+
+void PageArena::deallocate(std::size_t first, std::size_t count)
+{
+	if (count == 0)
+		return;
+	in_use_ -= count;
+	auto it = free_.emplace(first, count).first;
+
+	// merge with the following and the preceding run
+	const auto next = std::next(it);
+	if (next != free_.end() && first + it->second == next->first)
+	{
+		it->second += next->second;
+		free_.erase(next);
+	}
+	if (it != free_.begin())
+	{
+		const auto prev = std::prev(it);
+		if (prev->first + prev->second == first)
+		{
+			prev->second += it->second;
+			free_.erase(it);
+		}
+	}
+}
+
+void PageArena::grow(std::size_t pages)
+{
+	if (pages == 0)
+		return;
+	const auto first = capacity_;
+	capacity_ += pages;
+	in_use_ += pages; // deallocate() takes them off again
+	deallocate(first, pages);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+
+namespace mycraft
+{
+
+// First-fit allocator of runs of equal-sized pages within a range that
+// only grows. The Renderer packs every chunk mesh into one vertex buffer
+// with it; it only does the bookkeeping, the caller owns the memory.
+class PageArena
+{
+public:
+	constexpr static std::size_t npos = static_cast<std::size_t>(-1);
+
+	explicit PageArena(std::size_t pages = 0);
+
+	// The first page of a free run of count pages, or npos if there is
+	// none; grow() and try again.
+	std::size_t allocate(std::size_t count);
+	void deallocate(std::size_t first, std::size_t count);
+
+	// Appends pages free pages at the end.
+	void grow(std::size_t pages);
+
+	std::size_t capacity() const
+	{
+		return capacity_;
+	}
+
+	std::size_t pages_in_use() const
+	{
+		return in_use_;
+	}
+
+private:
+	// free runs: first page -> length, never adjacent to each other
+	std::map<std::size_t, std::size_t> free_;
+	std::size_t capacity_ = 0;
+	std::size_t in_use_ = 0;
+};
+
+}
@@ -1,20 +1,22 @@
 #include "perlin.h"
-#include <vector>
+#include <algorithm>
 #include <cmath>
 
-using std::unique_ptr;
-
 using namespace mycraft::perlin;
 
 double mycraft::perlin::perlin3d(double x, double y, double z)
 {
 
-	auto xi = (int) x % 256;
-	auto yi = (int) y % 256;
-	auto zi = (int) z % 256;
-	auto xf = std::fmod(x, 256) - xi;
-	auto yf = std::fmod(y, 256) - yi;
-	auto zf = std::fmod(z, 256) - zi;
+	// floor (not truncation) so that negative coordinates tile seamlessly
+	const auto xfl = std::floor(x);
+	const auto yfl = std::floor(y);
+	const auto zfl = std::floor(z);
+	auto xi = (int) xfl & 255;
+	auto yi = (int) yfl & 255;
+	auto zi = (int) zfl & 255;
+	auto xf = x - xfl;
+	auto yf = y - yfl;
+	auto zf = z - zfl;
 	auto u = fade(xf);
 	auto v = fade(yf);
 	auto w = fade(zf);
@@ -38,101 +40,101 @@ double mycraft::perlin::perlin3d(double x, double y, double z)
 	return (lerp(y1, y2, w) + 1) / 2;
 }
 
-Image3DResult mycraft::perlin::perlin3d_image(int x, int y, int z,
-		int cell_size, int layers)
+namespace
 {
-	std::unique_ptr<double[]> tmp(new double[x * y * z * layers]);
-	const auto a3 = y * z * layers;
-	const auto a2 = z * layers;
-	const auto a1 = layers;
 
-	for (int l = 0; l < layers; l++)
-	{
-		for (int i = 0; i < x; i++)
-		{
-			for (int j = 0; j < y; j++)
-			{
-				for (int k = 0; k < z; k++)
-				{
-					auto amplitude = 1.0 / std::pow(2, l);
-					auto frequency = std::pow(2, l);
-					auto period = cell_size / frequency;
-					tmp[i * a3 + j * a2 + k * a1 + l] = perlin3d(i / period,
-							j / period, k / period) * amplitude;
-				}
-			}
-		}
-	}
+// points per perlin3d_batch call; small enough for the stack
+constexpr int batch_points = 64;
 
-	unique_ptr<double[]> result(new double[x * y * z]);
-	for (int i = 0; i < x; i++)
-		for (int j = 0; j < y; j++)
-			for (int k = 0; k < z; k++)
-				result[i * y * z + j * z + k] = 0;
+// Evaluates one octave along a row of n points and adds it, scaled by
+// amplitude, to row (or stores it if first). The row runs along y
+// (vary_axis == 1) or z (vary_axis == 2) starting at origin; the other
+// two coordinates are the fixed values a and b, already scaled.
+void octave_row(double *row, int n, double a, double b, double origin,
+		double period, double amplitude, bool first, int vary_axis)
+{
+	double xs[batch_points], ys[batch_points], zs[batch_points];
+	double values[batch_points];
+	double *vary = vary_axis == 1 ? ys : zs;
+	double *fixed = vary_axis == 1 ? zs : ys;
 
-	for (int l = 0; l < layers; l++)
+	for (int k0 = 0; k0 < n; k0 += batch_points)
 	{
-		for (int i = 0; i < x; i++)
+		const int m = std::min(batch_points, n - k0);
+		for (int k = 0; k < m; k++)
 		{
-			for (int j = 0; j < y; j++)
-			{
-				for (int k = 0; k < z; k++)
-				{
-					result[i * y * z + j * z + k] += tmp[i * a3 + j * a2
-							+ k * a1 + l];
-				}
-			}
+			xs[k] = a;
+			fixed[k] = b;
+			vary[k] = (origin + (k0 + k)) / period;
 		}
+		perlin3d_batch(xs, ys, zs, values, m);
+
+		double *dst = row + k0;
+		if (first)
+			for (int k = 0; k < m; k++)
+				dst[k] = values[k] * amplitude;
+		else
+			for (int k = 0; k < m; k++)
+				dst[k] += values[k] * amplitude;
 	}
+}
 
-	for (int i = 0; i < x; i++)
-		for (int j = 0; j < y; j++)
-			for (int k = 0; k < z; k++)
-				result[i * y * z + j * z + k] /= layers;
-
-	return result;
 }
 
-Image2DResult mycraft::perlin::perlin2d_image(int height, int width,
-		int cell_size, int layers)
+void mycraft::perlin::perlin3d_fractal(double *out, int x, int y, int z,
+		int cell_size, int layers, double origin_x, double origin_y,
+		double origin_z)
 {
-	std::unique_ptr<double[]> tmp(new double[height * width * layers]);
-	const auto a2 = width * layers;
-
-	for (int k = 0; k < layers; k++)
+	for (int i = 0; i < x; i++)
 	{
-		for (int i = 0; i < height; i++)
+		for (int j = 0; j < y; j++)
 		{
-			for (int j = 0; j < width; j++)
+			// every octave of a row while it is still in cache
+			double *row = out + ((std::size_t) i * y + j) * z;
+			for (int l = 0; l < layers; l++)
 			{
-				auto amplitude = 1.0 / std::pow(2, k);
-				auto frequency = std::pow(2, k);
-				auto period = cell_size / frequency;
-				tmp[i * a2 + j * layers + k] = perlin2d(i / period, j / period)
-						* amplitude;
+				const auto oct = octave(cell_size, l);
+				octave_row(row, z, (origin_x + i) / oct.period,
+						(origin_y + j) / oct.period, origin_z, oct.period,
+						oct.amplitude, l == 0, 2);
 			}
+			for (int k = 0; k < z; k++)
+				row[k] /= layers;
 		}
 	}
+}
 
-	unique_ptr<double[]> result(new double[height * width]);
+void mycraft::perlin::perlin2d_fractal(double *out, int height, int width,
+		int cell_size, int layers)
+{
 	for (int i = 0; i < height; i++)
-		for (int j = 0; j < width; j++)
-			result[i * width + j] = 0;
-
-	for (int k = 0; k < layers; k++)
 	{
-		for (int i = 0; i < height; i++)
+		double *row = out + (std::size_t) i * width;
+		for (int l = 0; l < layers; l++)
 		{
-			for (int j = 0; j < width; j++)
-			{
-				result[i * width + j] += tmp[i * a2 + j * layers + k];
-			}
+			const auto oct = octave(cell_size, l);
+			octave_row(row, width, i / oct.period, 0, 0, oct.period,
+					oct.amplitude, l == 0, 1);
 		}
+		for (int j = 0; j < width; j++)
+			row[j] /= layers;
 	}
+}
 
-	for (int i = 0; i < height; i++)
-		for (int j = 0; j < width; j++)
-			result[i * width + j] /= layers;
+Image3DResult mycraft::perlin::perlin3d_image(int x, int y, int z,
+		int cell_size, int layers, double origin_x, double origin_y,
+		double origin_z)
+{
+	Image3DResult result(new double[(std::size_t) x * y * z]);
+	perlin3d_fractal(result.get(), x, y, z, cell_size, layers, origin_x,
+			origin_y, origin_z);
+	return result;
+}
 
+Image2DResult mycraft::perlin::perlin2d_image(int height, int width,
+		int cell_size, int layers)
+{
+	Image2DResult result(new double[(std::size_t) height * width]);
+	perlin2d_fractal(result.get(), height, width, cell_size, layers);
 	return result;
 }
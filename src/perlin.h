@@ -2,6 +2,7 @@
 
 #include <array>
 #include <memory>
+#include <cstddef>
 
 namespace mycraft::perlin
 {
@@ -97,14 +98,67 @@ constexpr double lerp(double a, double b, double x)
 
 double perlin3d(double x, double y, double z);
 
+enum class SimdLevel
+{
+	SCALAR, SSE2, AVX2
+};
+
+// Best level supported by this CPU.
+SimdLevel simd_level();
+
+// Evaluates perlin3d at the n points (x[i], y[i], z[i]) into out[i],
+// several points per instruction where the CPU allows. The vector paths
+// perform the same IEEE operations in the same order as perlin3d, so
+// the results are bit-identical as long as the compiler does not fuse
+// multiply-adds in perlin3d (the default unless built with -mfma or
+// -march=native); with fused scalar code they differ by at most 1e-12.
+void perlin3d_batch(const double *x, const double *y, const double *z,
+		double *out, std::size_t n);
+// Same, forcing a level (which must be <= simd_level()).
+void perlin3d_batch(const double *x, const double *y, const double *z,
+		double *out, std::size_t n, SimdLevel level);
+
+// Scale of octave l of fractal noise with the given base cell size:
+// sampled at 2^l times the base frequency, weighted by 2^-l.
+struct Octave
+{
+	double period;
+	double amplitude;
+};
+
+constexpr Octave octave(int cell_size, int l)
+{
+	double frequency = 1;
+	for (int i = 0; i < l; i++)
+		frequency *= 2;
+	return Octave
+	{ cell_size / frequency, 1 / frequency };
+}
+
+// Fractal noise: the mean of layers octaves of perlin3d over an x*y*z
+// grid starting at (origin_x, origin_y, origin_z), written to
+// out[(i * y + j) * z + k]. out must hold x*y*z doubles; nothing is
+// allocated.
+void perlin3d_fractal(double *out, int x, int y, int z, int cell_size,
+		int layers, double origin_x = 0, double origin_y = 0,
+		double origin_z = 0);
+
 using Image3DResult = std::unique_ptr<double[]>;
-Image3DResult perlin3d_image(int x, int y, int z, int cell_size, int layers);
+// Samples an x*y*z grid whose first point is at (origin_x, origin_y,
+// origin_z), so that neighbouring images line up at their borders.
+Image3DResult perlin3d_image(int x, int y, int z, int cell_size, int layers,
+		double origin_x = 0, double origin_y = 0, double origin_z = 0);
+
 
 inline double perlin2d(double x, double y)
 {
 	return perlin3d(x, y, 0);
 }
 
+// 2D counterpart of perlin3d_fractal, written to out[i * width + j].
+void perlin2d_fractal(double *out, int height, int width, int cell_size,
+		int layers);
+
 using Image2DResult = std::unique_ptr<double[]>;
 Image2DResult perlin2d_image(int height, int width, int cell_size, int layers);
 }
@@ -0,0 +1,307 @@
+/*
+ * Batched perlin3d. The vector kernels mirror perlin3d step by step
+ * (same operations, same order), only the permutation lookups and the
+ * gradient switch are rewritten: lookups become gathers and grad() the
+ * branch-free form of the same table.
+ */
+
+#include "perlin.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYCRAFT_PERLIN_X86
+#endif
+
+using namespace mycraft::perlin;
+
+namespace
+{
+
+void batch_scalar(const double *x, const double *y, const double *z,
+		double *out, std::size_t n)
+{
+	for (std::size_t i = 0; i < n; i++)
+		out[i] = perlin3d(x[i], y[i], z[i]);
+}
+
+#ifdef MYCRAFT_PERLIN_X86
+
+// ---- SSE2: 2 lanes, permutation lookups done per lane ----
+
+__attribute__((target("sse2")))
+inline __m128d blend2(__m128d mask, __m128d a, __m128d b)
+{
+	// mask ? a : b
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+__attribute__((target("sse2")))
+inline __m128d widen2(__m128i mask32)
+{
+	// 0 / -1 in the low two 32-bit lanes -> 0 / -1 in two 64-bit lanes
+	return _mm_castsi128_pd(_mm_unpacklo_epi32(mask32, mask32));
+}
+
+__attribute__((target("sse2")))
+inline __m128d floor2(__m128d x)
+{
+	const __m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+	return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, x), _mm_set1_pd(1)));
+}
+
+__attribute__((target("sse2")))
+inline __m128d fade2(__m128d t)
+{
+	const __m128d ttt = _mm_mul_pd(_mm_mul_pd(t, t), t);
+	const __m128d poly = _mm_add_pd(
+			_mm_mul_pd(t,
+					_mm_sub_pd(_mm_mul_pd(t, _mm_set1_pd(6)),
+							_mm_set1_pd(15))), _mm_set1_pd(10));
+	return _mm_mul_pd(ttt, poly);
+}
+
+__attribute__((target("sse2")))
+inline __m128d lerp2(__m128d a, __m128d b, __m128d x)
+{
+	return _mm_add_pd(a, _mm_mul_pd(x, _mm_sub_pd(b, a)));
+}
+
+__attribute__((target("sse2")))
+inline __m128d grad2(__m128i h, __m128d x, __m128d y, __m128d z)
+{
+	h = _mm_and_si128(h, _mm_set1_epi32(15));
+	const __m128d lt8 = widen2(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+	const __m128d lt4 = widen2(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	const __m128d h12_14 = widen2(
+			_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+					_mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+	const __m128d neg_u = widen2(
+			_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)),
+					_mm_set1_epi32(1)));
+	const __m128d neg_v = widen2(
+			_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)),
+					_mm_set1_epi32(2)));
+
+	const __m128d sign = _mm_set1_pd(-0.0);
+	__m128d u = blend2(lt8, x, y);
+	__m128d v = blend2(lt4, y, blend2(h12_14, x, z));
+	u = _mm_xor_pd(u, _mm_and_pd(neg_u, sign));
+	v = _mm_xor_pd(v, _mm_and_pd(neg_v, sign));
+	return _mm_add_pd(u, v);
+}
+
+__attribute__((target("sse2")))
+void batch_sse2(const double *x, const double *y, const double *z,
+		double *out, std::size_t n)
+{
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		const __m128d X = _mm_loadu_pd(x + i);
+		const __m128d Y = _mm_loadu_pd(y + i);
+		const __m128d Z = _mm_loadu_pd(z + i);
+		const __m128d xfl = floor2(X);
+		const __m128d yfl = floor2(Y);
+		const __m128d zfl = floor2(Z);
+
+		alignas(16) int xi[4], yi[4], zi[4];
+		_mm_store_si128((__m128i*) xi, _mm_cvttpd_epi32(xfl));
+		_mm_store_si128((__m128i*) yi, _mm_cvttpd_epi32(yfl));
+		_mm_store_si128((__m128i*) zi, _mm_cvttpd_epi32(zfl));
+
+		alignas(16) int h[8][4] = {};
+		for (int l = 0; l < 2; l++)
+		{
+			const int a = xi[l] & 255, b = yi[l] & 255, c = zi[l] & 255;
+			const int A = p[a], B = p[a + 1];
+			const int AA = p[A + b], AB = p[A + b + 1];
+			const int BA = p[B + b], BB = p[B + b + 1];
+			h[0][l] = p[AA + c];     // aaa
+			h[1][l] = p[BA + c];     // baa
+			h[2][l] = p[AB + c];     // aba
+			h[3][l] = p[BB + c];     // bba
+			h[4][l] = p[AA + c + 1]; // aab
+			h[5][l] = p[BA + c + 1]; // bab
+			h[6][l] = p[AB + c + 1]; // abb
+			h[7][l] = p[BB + c + 1]; // bbb
+		}
+		auto hv = [&h](int k)
+		{	return _mm_load_si128((const __m128i*) h[k]);};
+
+		const __m128d one = _mm_set1_pd(1);
+		const __m128d xf = _mm_sub_pd(X, xfl);
+		const __m128d yf = _mm_sub_pd(Y, yfl);
+		const __m128d zf = _mm_sub_pd(Z, zfl);
+		const __m128d xf1 = _mm_sub_pd(xf, one);
+		const __m128d yf1 = _mm_sub_pd(yf, one);
+		const __m128d zf1 = _mm_sub_pd(zf, one);
+		const __m128d u = fade2(xf);
+		const __m128d v = fade2(yf);
+		const __m128d w = fade2(zf);
+
+		__m128d x1 = lerp2(grad2(hv(0), xf, yf, zf), grad2(hv(1), xf1, yf, zf), u);
+		__m128d x2 = lerp2(grad2(hv(2), xf, yf1, zf), grad2(hv(3), xf1, yf1, zf), u);
+		const __m128d y1 = lerp2(x1, x2, v);
+		x1 = lerp2(grad2(hv(4), xf, yf, zf1), grad2(hv(5), xf1, yf, zf1), u);
+		x2 = lerp2(grad2(hv(6), xf, yf1, zf1), grad2(hv(7), xf1, yf1, zf1), u);
+		const __m128d y2 = lerp2(x1, x2, v);
+		_mm_storeu_pd(out + i,
+				_mm_div_pd(_mm_add_pd(lerp2(y1, y2, w), one), _mm_set1_pd(2)));
+	}
+	batch_scalar(x + i, y + i, z + i, out + i, n - i);
+}
+
+// ---- AVX2: 4 lanes, permutation lookups as gathers ----
+
+__attribute__((target("avx2")))
+inline __m256d widen4(__m128i mask32)
+{
+	return _mm256_castsi256_pd(_mm256_cvtepi32_epi64(mask32));
+}
+
+__attribute__((target("avx2")))
+inline __m256d fade4(__m256d t)
+{
+	const __m256d ttt = _mm256_mul_pd(_mm256_mul_pd(t, t), t);
+	const __m256d poly = _mm256_add_pd(
+			_mm256_mul_pd(t,
+					_mm256_sub_pd(_mm256_mul_pd(t, _mm256_set1_pd(6)),
+							_mm256_set1_pd(15))), _mm256_set1_pd(10));
+	return _mm256_mul_pd(ttt, poly);
+}
+
+__attribute__((target("avx2")))
+inline __m256d lerp4(__m256d a, __m256d b, __m256d x)
+{
+	return _mm256_add_pd(a, _mm256_mul_pd(x, _mm256_sub_pd(b, a)));
+}
+
+__attribute__((target("avx2")))
+inline __m256d grad4(__m128i h, __m256d x, __m256d y, __m256d z)
+{
+	h = _mm_and_si128(h, _mm_set1_epi32(15));
+	const __m256d lt8 = widen4(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+	const __m256d lt4 = widen4(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+	const __m256d h12_14 = widen4(
+			_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+					_mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+	const __m256d neg_u = widen4(
+			_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)),
+					_mm_set1_epi32(1)));
+	const __m256d neg_v = widen4(
+			_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)),
+					_mm_set1_epi32(2)));
+
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	__m256d u = _mm256_blendv_pd(y, x, lt8);
+	__m256d v = _mm256_blendv_pd(_mm256_blendv_pd(z, x, h12_14), y, lt4);
+	u = _mm256_xor_pd(u, _mm256_and_pd(neg_u, sign));
+	v = _mm256_xor_pd(v, _mm256_and_pd(neg_v, sign));
+	return _mm256_add_pd(u, v);
+}
+
+__attribute__((target("avx2")))
+inline __m128i lookup4(__m128i idx)
+{
+	return _mm_i32gather_epi32(p.data(), idx, 4);
+}
+
+__attribute__((target("avx2")))
+void batch_avx2(const double *x, const double *y, const double *z,
+		double *out, std::size_t n)
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m256d X = _mm256_loadu_pd(x + i);
+		const __m256d Y = _mm256_loadu_pd(y + i);
+		const __m256d Z = _mm256_loadu_pd(z + i);
+		const __m256d xfl = _mm256_floor_pd(X);
+		const __m256d yfl = _mm256_floor_pd(Y);
+		const __m256d zfl = _mm256_floor_pd(Z);
+
+		const __m128i mask = _mm_set1_epi32(255);
+		const __m128i one_i = _mm_set1_epi32(1);
+		const __m128i xi = _mm_and_si128(_mm256_cvttpd_epi32(xfl), mask);
+		const __m128i yi = _mm_and_si128(_mm256_cvttpd_epi32(yfl), mask);
+		const __m128i zi = _mm_and_si128(_mm256_cvttpd_epi32(zfl), mask);
+		const __m128i yi1 = _mm_add_epi32(yi, one_i);
+		const __m128i zi1 = _mm_add_epi32(zi, one_i);
+
+		const __m128i A = lookup4(xi);
+		const __m128i B = lookup4(_mm_add_epi32(xi, one_i));
+		const __m128i AA = lookup4(_mm_add_epi32(A, yi));
+		const __m128i AB = lookup4(_mm_add_epi32(A, yi1));
+		const __m128i BA = lookup4(_mm_add_epi32(B, yi));
+		const __m128i BB = lookup4(_mm_add_epi32(B, yi1));
+
+		const __m256d one = _mm256_set1_pd(1);
+		const __m256d xf = _mm256_sub_pd(X, xfl);
+		const __m256d yf = _mm256_sub_pd(Y, yfl);
+		const __m256d zf = _mm256_sub_pd(Z, zfl);
+		const __m256d xf1 = _mm256_sub_pd(xf, one);
+		const __m256d yf1 = _mm256_sub_pd(yf, one);
+		const __m256d zf1 = _mm256_sub_pd(zf, one);
+		const __m256d u = fade4(xf);
+		const __m256d v = fade4(yf);
+		const __m256d w = fade4(zf);
+
+		__m256d x1 = lerp4(grad4(lookup4(_mm_add_epi32(AA, zi)), xf, yf, zf),
+				grad4(lookup4(_mm_add_epi32(BA, zi)), xf1, yf, zf), u);
+		__m256d x2 = lerp4(grad4(lookup4(_mm_add_epi32(AB, zi)), xf, yf1, zf),
+				grad4(lookup4(_mm_add_epi32(BB, zi)), xf1, yf1, zf), u);
+		const __m256d y1 = lerp4(x1, x2, v);
+		x1 = lerp4(grad4(lookup4(_mm_add_epi32(AA, zi1)), xf, yf, zf1),
+				grad4(lookup4(_mm_add_epi32(BA, zi1)), xf1, yf, zf1), u);
+		x2 = lerp4(grad4(lookup4(_mm_add_epi32(AB, zi1)), xf, yf1, zf1),
+				grad4(lookup4(_mm_add_epi32(BB, zi1)), xf1, yf1, zf1), u);
+		const __m256d y2 = lerp4(x1, x2, v);
+		_mm256_storeu_pd(out + i,
+				_mm256_div_pd(_mm256_add_pd(lerp4(y1, y2, w), one),
+						_mm256_set1_pd(2)));
+	}
+	batch_scalar(x + i, y + i, z + i, out + i, n - i);
+}
+
+#endif
+
+}
+
+SimdLevel mycraft::perlin::simd_level()
+{
+#ifdef MYCRAFT_PERLIN_X86
+	static const SimdLevel level =
+			__builtin_cpu_supports("avx2") ? SimdLevel::AVX2 :
+			__builtin_cpu_supports("sse2") ?
+					SimdLevel::SSE2 : SimdLevel::SCALAR;
+	return level;
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+void mycraft::perlin::perlin3d_batch(const double *x, const double *y,
+		const double *z, double *out, std::size_t n)
+{
+	perlin3d_batch(x, y, z, out, n, simd_level());
+}
+
+void mycraft::perlin::perlin3d_batch(const double *x, const double *y,
+		const double *z, double *out, std::size_t n, SimdLevel level)
+{
+	switch (level)
+	{
+#ifdef MYCRAFT_PERLIN_X86
+	case SimdLevel::AVX2:
+		batch_avx2(x, y, z, out, n);
+		break;
+	case SimdLevel::SSE2:
+		batch_sse2(x, y, z, out, n);
+		break;
+#endif
+	default:
+		batch_scalar(x, y, z, out, n);
+		break;
+	}
+}
@@ -0,0 +1,133 @@
+#include "raycast.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr TexDir entered_face[3][2] =
+{
+{ TEX_XNEG, TEX_XPOS },
+{ TEX_YNEG, TEX_YPOS },
+{ TEX_ZNEG, TEX_ZPOS } };
+
+constexpr CoordElem chunk_size[3] =
+{ Chunk::chunk_length, Chunk::chunk_length, Chunk::chunk_height };
+
+// the chunk a walk is in, kept across walks
+class ChunkCursor
+{
+public:
+	explicit ChunkCursor(const World &world) :
+			world_(world)
+	{
+	}
+
+	const Chunk* at(const ChunkCoord &c)
+	{
+		if (!valid_ || c != coord_)
+		{
+			coord_ = c;
+			chunk_ = world_.find_chunk(c);
+			valid_ = true;
+		}
+		return chunk_;
+	}
+
+private:
+	const World &world_;
+	ChunkCoord coord_;
+	const Chunk *chunk_ = nullptr;
+	bool valid_ = false;
+};
+
+std::optional<RayHit> walk(ChunkCursor &cursor, const Ray &ray,
+		float max_distance)
+{
+	const double length = std::sqrt(
+			(double) ray.direction[0] * ray.direction[0]
+					+ (double) ray.direction[1] * ray.direction[1]
+					+ (double) ray.direction[2] * ray.direction[2]);
+	if (length == 0)
+		return {};
+
+	constexpr double never = std::numeric_limits<double>::infinity();
+	std::int64_t block[3];
+	int step[3];
+	// distance to the next block border on each axis, and between borders
+	double next[3], delta[3];
+	int main_axis = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		const double o = ray.origin[a], d = ray.direction[a] / length;
+		block[a] = (std::int64_t) std::floor(o);
+		step[a] = d > 0 ? 1 : d < 0 ? -1 : 0;
+		delta[a] = step[a] ? 1 / std::abs(d) : never;
+		next[a] = step[a] > 0 ? (block[a] + 1 - o) / d :
+					step[a] < 0 ? (block[a] - o) / d : never;
+		if (std::abs(ray.direction[a]) > std::abs(ray.direction[main_axis]))
+			main_axis = a;
+	}
+
+	CoordElem local[3];
+	ChunkCoord coord = block_chunk(block[0], block[1], block[2], local);
+	const Chunk *chunk = cursor.at(coord);
+	TexDir face = entered_face[main_axis][step[main_axis] < 0];
+	double t = 0;
+	for (;;)
+	{
+		if (chunk)
+		{
+			const block_id_t id = chunk->block_id(local[0], local[1],
+					local[2]);
+			if (id != 0)
+				return RayHit
+				{
+				{ block[0], block[1], block[2] }, id, face, (float) t };
+		}
+
+		const int a = next[0] < next[1] ?
+				(next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+		t = next[a];
+		if (t > max_distance)
+			return {};
+		next[a] += delta[a];
+		block[a] += step[a];
+		face = entered_face[a][step[a] < 0];
+
+		local[a] += step[a];
+		if (local[a] < 0 || local[a] >= chunk_size[a])
+		{
+			local[a] -= step[a] * chunk_size[a];
+			coord = ChunkCoord(coord.x() + (a == 0 ? step[a] : 0),
+					coord.y() + (a == 1 ? step[a] : 0),
+					coord.z() + (a == 2 ? step[a] : 0));
+			chunk = cursor.at(coord);
+		}
+	}
+}
+
+}
+
+std::optional<RayHit> mycraft::raycast(const World &world, const Ray &ray,
+		float max_distance)
+{
+	ChunkCursor cursor(world);
+	return walk(cursor, ray, max_distance);
+}
+
+std::size_t mycraft::raycast(const World &world, const Ray *rays,
+		std::size_t count, float max_distance, std::optional<RayHit> *hits)
+{
+	ChunkCursor cursor(world);
+	std::size_t hit = 0;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		hits[i] = walk(cursor, rays[i], max_distance);
+		hit += hits[i].has_value();
+	}
+	return hit;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include "block.h"
+#include "block_registry.h"
+#include "world.h"
+
+namespace mycraft
+{
+
+// A ray in world (block) coordinates; direction need not be normalized.
+struct Ray
+{
+	float origin[3];
+	float direction[3];
+};
+
+struct RayHit
+{
+	std::int64_t block[3];
+	block_id_t id;
+	// the face of the block the ray entered through; for a ray starting
+	// inside a block, the one facing back along its main axis
+	TexDir face;
+	// along the ray from its origin, in blocks
+	float distance;
+};
+
+// Walks the blocks a ray passes through in order (Amanatides & Woo) up to
+// max_distance and returns the first one that is not air. The walk keeps
+// the chunk it is in and its position inside it, so a chunk lookup only
+// happens when it crosses a chunk border; chunks that are not stored read
+// as air.
+std::optional<RayHit> raycast(const World &world, const Ray &ray,
+		float max_distance);
+
+// raycast() for each of count rays into hits, sharing the current chunk
+// between consecutive rays (rays from one place start in one chunk).
+// Returns the number of rays that hit.
+std::size_t raycast(const World &world, const Ray *rays, std::size_t count,
+		float max_distance, std::optional<RayHit> *hits);
+
+}
@@ -0,0 +1,233 @@
+#include "region_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr char magic[4] =
+{ 'M', 'C', 'R', 'G' };
+constexpr std::uint32_t version = 1;
+constexpr std::size_t header_bytes = 16;
+constexpr std::size_t page = 4096;
+
+static_assert(sizeof(Block) == 1 && std::is_trivially_copyable<Block>::value,
+		"chunk payloads are stored as raw block ids");
+
+constexpr std::size_t table_entries = RegionFile::region_length
+		* RegionFile::region_length * RegionFile::region_length;
+
+constexpr std::size_t align_up(std::size_t n)
+{
+	return (n + page - 1) / page * page;
+}
+
+[[noreturn]] void fail(const std::string &path, const char *what)
+{
+	throw RegionFileError(path + ": " + what + ": " + std::strerror(errno));
+}
+
+// negative chunk coordinates get their own regions
+CoordElem region_coord(CoordElem c)
+{
+	return (CoordElem) floor_div(c, RegionFile::region_length);
+}
+
+}
+
+RegionFile::RegionFile(const std::string &path) :
+		path_(path), table_(table_entries, Entry
+		{ 0, 0 })
+{
+	fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd_ < 0)
+		fail(path_, "open");
+
+	struct stat st;
+	if (::fstat(fd_, &st) != 0)
+		fail(path_, "fstat");
+	file_size_ = st.st_size;
+
+	const std::size_t table_bytes = table_entries * sizeof(Entry);
+	if (file_size_ == 0)
+	{
+		std::uint8_t header[header_bytes] = {};
+		std::memcpy(header, magic, 4);
+		std::memcpy(header + 4, &version, 4);
+		const std::uint32_t length = region_length;
+		std::memcpy(header + 8, &length, 4);
+		file_size_ = align_up(header_bytes + table_bytes);
+		if (::ftruncate(fd_, file_size_) != 0
+				|| ::pwrite(fd_, header, header_bytes, 0) != header_bytes)
+			fail(path_, "create");
+	}
+	else
+	{
+		std::uint8_t header[header_bytes];
+		std::uint32_t file_version, length;
+		if (::pread(fd_, header, header_bytes, 0) != header_bytes)
+			fail(path_, "read header");
+		std::memcpy(&file_version, header + 4, 4);
+		std::memcpy(&length, header + 8, 4);
+		if (std::memcmp(header, magic, 4) != 0 || file_version != version
+				|| length != region_length)
+			throw RegionFileError(path_ + ": not a region file");
+		if (::pread(fd_, table_.data(), table_bytes, header_bytes)
+				!= (ssize_t) table_bytes)
+			fail(path_, "read table");
+	}
+
+	remap(file_size_);
+}
+
+RegionFile::~RegionFile()
+{
+	if (map_)
+		::munmap(const_cast<std::uint8_t*>(map_), map_size_);
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+std::size_t RegionFile::entry_index(int lx, int ly, int lz)
+{
+	return ((std::size_t) lx * region_length + ly) * region_length + lz;
+}
+
+void RegionFile::remap(std::size_t min_size)
+{
+	// pages past the end of the file are never read: read() only reads
+	// chunks in the file
+	const std::size_t size = align_up(std::max(min_size, map_size_ * 2));
+	void *p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+	if (p == MAP_FAILED)
+		fail(path_, "mmap");
+	if (map_)
+		::munmap(const_cast<std::uint8_t*>(map_), map_size_);
+	map_ = static_cast<const std::uint8_t*>(p);
+	map_size_ = size;
+}
+
+bool RegionFile::read(int lx, int ly, int lz, PalettedBlocks &blocks)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	const Entry &e = table_[entry_index(lx, ly, lz)];
+	if (e.offset == 0 || e.size != payload_bytes)
+		return false;
+	// chunks appended since the file was mapped
+	if (e.offset + e.size > map_size_)
+		remap(file_size_);
+	// no copy of the expanded blocks: the palette is built from the page
+	// cache
+	blocks = PalettedBlocks(reinterpret_cast<const Block*>(map_ + e.offset),
+			Chunk::block_count);
+	return true;
+}
+
+void RegionFile::write(int lx, int ly, int lz, const Chunk::ChunkData &data)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	const std::size_t index = entry_index(lx, ly, lz);
+	Entry &e = table_[index];
+	if (e.offset == 0)
+	{
+		e.offset = align_up(file_size_);
+		e.size = payload_bytes;
+		file_size_ = e.offset + payload_bytes;
+	}
+
+	if (::pwrite(fd_, data.data(), payload_bytes, e.offset)
+			!= (ssize_t) payload_bytes)
+		fail(path_, "write chunk");
+	if (::pwrite(fd_, &e, sizeof(Entry), header_bytes + index * sizeof(Entry))
+			!= sizeof(Entry))
+		fail(path_, "write table");
+}
+
+void RegionFile::sync()
+{
+	if (::fsync(fd_) != 0)
+		fail(path_, "fsync");
+}
+
+std::size_t RegionFile::chunk_count() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::size_t count = 0;
+	for (const auto &e : table_)
+		count += e.offset != 0;
+	return count;
+}
+
+RegionStore::RegionStore(std::string directory) :
+		directory_(std::move(directory))
+{
+	std::error_code ec;
+	std::filesystem::create_directories(directory_, ec);
+	if (ec)
+		throw RegionFileError(directory_ + ": " + ec.message());
+}
+
+RegionFile& RegionStore::region(const ChunkCoord &coord, int (&local)[3])
+{
+	const ChunkCoord r(region_coord(coord.x()), region_coord(coord.y()),
+			region_coord(coord.z()));
+	local[0] = coord.x() - r.x() * RegionFile::region_length;
+	local[1] = coord.y() - r.y() * RegionFile::region_length;
+	local[2] = coord.z() - r.z() * RegionFile::region_length;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto &file = regions_[pack_chunk_coord(r)];
+	if (!file)
+		file = std::make_unique<RegionFile>(
+				directory_ + "/r." + std::to_string(r.x()) + "."
+						+ std::to_string(r.y()) + "." + std::to_string(r.z())
+						+ ".mcr");
+	return *file;
+}
+
+std::shared_ptr<Chunk> RegionStore::load(const ChunkCoord &coord)
+{
+	int l[3];
+	PalettedBlocks blocks;
+	if (!region(coord, l).read(l[0], l[1], l[2], blocks))
+		return nullptr;
+	return std::make_shared<Chunk>(std::move(blocks));
+}
+
+void RegionStore::save(const ChunkCoord &coord, const Chunk &chunk)
+{
+	int l[3];
+	region(coord, l).write(l[0], l[1], l[2], chunk.expanded());
+	chunk.set_needs_save(false);
+}
+
+std::size_t RegionStore::save_changed(const World &world)
+{
+	std::size_t saved = 0;
+	world.for_each_chunk(
+			[&](const ChunkCoord &coord, const std::shared_ptr<Chunk> &chunk)
+			{
+				if (!chunk->needs_save())
+					return;
+				save(coord, *chunk);
+				saved++;
+			});
+	return saved;
+}
+
+void RegionStore::sync()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto &r : regions_)
+		r.second->sync();
+}
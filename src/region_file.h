@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "world.h"
+
+namespace mycraft
+{
+
+struct RegionFileError: std::runtime_error
+{
+	RegionFileError(const std::string &what) :
+			std::runtime_error(what)
+	{
+	}
+};
+
+// One file holding the chunks of a region_length^3 block of chunk
+// coordinates. Layout (little endian):
+//
+//   header   magic "MCRG", u32 version, u32 region_length, u32 reserved
+//   table    region_length^3 entries of { u32 offset, u32 size },
+//            offset 0 meaning "not stored"
+//   payloads block ids of one chunk each, page aligned
+//
+// Reads go through a read-only mapping of the file, so looking a chunk
+// up copies nothing. Writes use pwrite; a chunk that is stored again
+// overwrites its payload in place. Thread-safe.
+class RegionFile
+{
+public:
+	static constexpr int region_length = 16;
+	static constexpr std::size_t payload_bytes = sizeof(Chunk::ChunkData);
+
+	// Opens path, creating an empty region file if it does not exist.
+	// Throws RegionFileError.
+	explicit RegionFile(const std::string &path);
+	RegionFile(const RegionFile&) = delete;
+	RegionFile& operator=(const RegionFile&) = delete;
+	~RegionFile();
+
+	// Compacts the stored block ids of the chunk at local coordinates
+	// (0 <= l[xyz] < region_length) straight out of the mapped file into
+	// blocks. False if the chunk is not stored.
+	bool read(int lx, int ly, int lz, PalettedBlocks &blocks);
+
+	void write(int lx, int ly, int lz, const Chunk::ChunkData &data);
+
+	// Flushes written data to the disk.
+	void sync();
+
+	std::size_t chunk_count() const;
+
+private:
+	struct Entry
+	{
+		std::uint32_t offset;
+		std::uint32_t size;
+	};
+
+	static std::size_t entry_index(int lx, int ly, int lz);
+	// maps at least min_size bytes, and then some, so that appending
+	// chunks remaps the file only now and then
+	void remap(std::size_t min_size);
+
+	std::string path_;
+	int fd_ = -1;
+	mutable std::mutex mutex_;
+	std::vector<Entry> table_;
+	std::size_t file_size_ = 0;
+	const std::uint8_t *map_ = nullptr;
+	std::size_t map_size_ = 0;
+};
+
+// The region files of a world, kept in one directory and opened on
+// demand. Thread-safe.
+class RegionStore
+{
+public:
+	// Creates directory if needed. Throws RegionFileError.
+	explicit RegionStore(std::string directory);
+
+	// The stored chunk at coord, or nullptr.
+	std::shared_ptr<Chunk> load(const ChunkCoord &coord);
+
+	// Stores chunk and clears its needs_save() flag.
+	void save(const ChunkCoord &coord, const Chunk &chunk);
+
+	// Writes back the chunks of world whose needs_save() is set and
+	// returns how many were written.
+	std::size_t save_changed(const World &world);
+
+	void sync();
+
+	const std::string& directory() const
+	{
+		return directory_;
+	}
+
+private:
+	RegionFile& region(const ChunkCoord &coord, int (&local)[3]);
+
+	std::string directory_;
+	std::mutex mutex_;
+	std::unordered_map<std::uint64_t, std::unique_ptr<RegionFile>> regions_;
+};
+
+}
@@ -0,0 +1,185 @@
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr char magic[4] =
+{ 'M', 'C', 'T', 'X' };
+constexpr std::uint32_t version = 1;
+constexpr std::size_t header_bytes = 40;
+constexpr std::size_t entry_bytes = 24;
+
+[[noreturn]] void fail(const std::string &path, const char *what)
+{
+	throw TextureCacheError(path + ": " + what + ": " + std::strerror(errno));
+}
+
+template<typename T>
+void put(std::vector<std::uint8_t> &out, std::size_t at, T value)
+{
+	std::memcpy(out.data() + at, &value, sizeof(T));
+}
+
+template<typename T>
+T get(const std::uint8_t *in, std::size_t at)
+{
+	T value;
+	std::memcpy(&value, in + at, sizeof(T));
+	return value;
+}
+
+}
+
+std::optional<SourceStamp> mycraft::source_stamp(const std::string &path)
+{
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(path, ec);
+	if (ec)
+		return {};
+	const auto mtime = std::filesystem::last_write_time(path, ec);
+	if (ec)
+		return {};
+	return SourceStamp
+	{ size, (std::int64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+			mtime.time_since_epoch()).count() };
+}
+
+MipChain::MipChain(const std::uint8_t *rgb, std::uint32_t width,
+		std::uint32_t height)
+{
+	pixels_.emplace_back(rgb, rgb + (std::size_t) width * height * 3);
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> sizes
+	{
+	{ width, height } };
+	const std::uint32_t min_width = std::max(width / atlas_tiles, 1u);
+	const std::uint32_t min_height = std::max(height / atlas_tiles, 1u);
+	while (width / 2 >= min_width && height / 2 >= min_height)
+	{
+		const auto &src = pixels_.back();
+		const std::uint32_t w = width / 2, h = height / 2;
+		std::vector<std::uint8_t> dst((std::size_t) w * h * 3);
+		for (std::uint32_t y = 0; y < h; y++)
+			for (std::uint32_t x = 0; x < w; x++)
+				for (int c = 0; c < 3; c++)
+				{
+					auto at = [&](std::uint32_t sx, std::uint32_t sy)
+					{	return (unsigned) src[((std::size_t) sy * width + sx) * 3 + c];};
+					const unsigned sum = at(2 * x, 2 * y) + at(2 * x + 1, 2 * y)
+							+ at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1);
+					dst[((std::size_t) y * w + x) * 3 + c] =
+							(std::uint8_t) ((sum + 2) / 4);
+				}
+		pixels_.push_back(std::move(dst));
+		sizes.emplace_back(w, h);
+		width = w;
+		height = h;
+	}
+	for (size_t i = 0; i < pixels_.size(); i++)
+		levels_.push_back(
+		{ sizes[i].first, sizes[i].second, pixels_[i].data() });
+}
+
+void mycraft::bake_texture(const std::string &path, const SourceStamp &source,
+		const MipChain &chain)
+{
+	const auto &levels = chain.levels();
+	std::size_t offset = header_bytes + levels.size() * entry_bytes;
+	std::vector<std::uint8_t> head(offset);
+	std::memcpy(head.data(), magic, 4);
+	put(head, 4, version);
+	put(head, 8, source.size);
+	put(head, 16, source.mtime_ns);
+	put(head, 24, levels[0].width);
+	put(head, 28, levels[0].height);
+	put(head, 32, (std::uint32_t) levels.size());
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		const std::size_t e = header_bytes + i * entry_bytes;
+		put(head, e, levels[i].width);
+		put(head, e + 4, levels[i].height);
+		put(head, e + 8, (std::uint64_t) offset);
+		put(head, e + 16, (std::uint64_t) levels[i].bytes());
+		offset += levels[i].bytes();
+	}
+
+	const std::string tmp = path + ".tmp";
+	std::FILE *f = std::fopen(tmp.c_str(), "wb");
+	if (!f)
+		fail(tmp, "open");
+	bool ok = std::fwrite(head.data(), 1, head.size(), f) == head.size();
+	for (const auto &level : levels)
+		ok = ok
+				&& std::fwrite(level.pixels, 1, level.bytes(), f)
+						== level.bytes();
+	ok = std::fclose(f) == 0 && ok;
+	if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+	{
+		const int error = errno;
+		std::remove(tmp.c_str());
+		errno = error;
+		fail(path, "write");
+	}
+}
+
+std::unique_ptr<BakedTexture> BakedTexture::open(const std::string &path,
+		const std::optional<SourceStamp> &source)
+{
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+	struct stat st;
+	void *p = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && (std::size_t) st.st_size >= header_bytes)
+		p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid without the descriptor
+	::close(fd);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	std::unique_ptr<BakedTexture> texture(
+			new BakedTexture(static_cast<const std::uint8_t*>(p),
+					st.st_size));
+	const std::uint8_t *map = texture->map_;
+	const std::size_t size = texture->size_;
+	if (std::memcmp(map, magic, 4) != 0 || get<std::uint32_t>(map, 4) != version)
+		return nullptr;
+	if (source
+			&& (get<std::uint64_t>(map, 8) != source->size
+					|| get<std::int64_t>(map, 16) != source->mtime_ns))
+		return nullptr;
+
+	const auto count = get<std::uint32_t>(map, 32);
+	if (count == 0 || header_bytes + (std::size_t) count * entry_bytes > size)
+		return nullptr;
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		const std::size_t e = header_bytes + i * entry_bytes;
+		const TextureLevel level
+		{ get<std::uint32_t>(map, e), get<std::uint32_t>(map, e + 4), nullptr };
+		const auto offset = get<std::uint64_t>(map, e + 8);
+		const auto bytes = get<std::uint64_t>(map, e + 16);
+		if (bytes != level.bytes() || offset > size || bytes > size - offset)
+			return nullptr;
+		texture->levels_.push_back(
+		{ level.width, level.height, map + offset });
+	}
+	return texture;
+}
+
+BakedTexture::~BakedTexture()
+{
+	::munmap(const_cast<std::uint8_t*>(map_), size_);
+}
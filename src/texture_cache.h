@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mycraft
+{
+
+struct TextureCacheError: std::runtime_error
+{
+	TextureCacheError(const std::string &what) :
+			std::runtime_error(what)
+	{
+	}
+};
+
+// Tiles per side of the texture atlas (see the fragment shader).
+constexpr std::uint32_t atlas_tiles = 16;
+
+// One mip level of an RGB8 image, rows tightly packed.
+struct TextureLevel
+{
+	std::uint32_t width, height;
+	const std::uint8_t *pixels;
+
+	std::size_t bytes() const
+	{
+		return (std::size_t) width * height * 3;
+	}
+};
+
+// Identifies the version of a source image a cache was baked from.
+struct SourceStamp
+{
+	std::uint64_t size;
+	std::int64_t mtime_ns;
+};
+
+// The stamp of the file at path; nullopt if it does not exist.
+std::optional<SourceStamp> source_stamp(const std::string &path);
+
+// An RGB8 image and its mip levels, each half the size of the previous
+// one (2x2 box filter), down to one pixel per atlas tile so that tiles
+// never blend into each other.
+class MipChain
+{
+public:
+	MipChain(const std::uint8_t *rgb, std::uint32_t width,
+			std::uint32_t height);
+	// the levels point into pixels_
+	MipChain(const MipChain&) = delete;
+	MipChain(MipChain&&) = default;
+
+	const std::vector<TextureLevel>& levels() const
+	{
+		return levels_;
+	}
+
+private:
+	std::vector<std::vector<std::uint8_t>> pixels_;
+	std::vector<TextureLevel> levels_;
+};
+
+// Writes the levels of chain to path as a baked texture of source,
+// through a temporary file that replaces path once complete. Layout
+// (little endian):
+//
+//   header  magic "MCTX", u32 version, u64 source size,
+//           i64 source mtime (ns), u32 width, u32 height, u32 levels,
+//           u32 reserved
+//   table   per level { u32 width, u32 height, u64 offset, u64 bytes }
+//   pixels  the levels, largest first
+//
+// Throws TextureCacheError.
+void bake_texture(const std::string &path, const SourceStamp &source,
+		const MipChain &chain);
+
+// A baked texture mapped read-only: its levels point into the mapping,
+// ready to upload, with nothing decoded or copied.
+class BakedTexture
+{
+public:
+	// nullptr if path is missing, malformed or (with a source) was baked
+	// from another version of the source.
+	static std::unique_ptr<BakedTexture> open(const std::string &path,
+			const std::optional<SourceStamp> &source);
+
+	BakedTexture(const BakedTexture&) = delete;
+	BakedTexture& operator=(const BakedTexture&) = delete;
+	~BakedTexture();
+
+	const std::vector<TextureLevel>& levels() const
+	{
+		return levels_;
+	}
+
+private:
+	BakedTexture(const std::uint8_t *map, std::size_t size) :
+			map_(map), size_(size)
+	{
+	}
+
+	const std::uint8_t *map_;
+	std::size_t size_;
+	std::vector<TextureLevel> levels_;
+};
+
+}
@@ -7,23 +7,286 @@
 
 
 #include "world.h"
+#include <algorithm>
 
 using namespace mycraft;
 
 
 Chunk::Chunk()
-	: data_() {}
+	: compact_(block_count) {}
+
+Chunk::Chunk(block_id_t fill)
+	: compact_(block_count, fill) {}
 
 Chunk::Chunk(const ChunkData& data)
-	: data_(data) {}
+	: data_(std::make_unique<ChunkData>(data)) {}
+
+Chunk::Chunk(PalettedBlocks blocks)
+	: compact_(std::move(blocks)) {}
+
+Chunk::Chunk(const Chunk& other)
+	: data_(other.data_ ? std::make_unique<ChunkData>(*other.data_) : nullptr)
+	, compact_(other.data_ ? PalettedBlocks() : other.compact_)
+	, light_(other.light_ ? std::make_unique<ChunkLight>(*other.light_) : nullptr)
+	, changed_(other.changed_)
+	, needs_save_(other.needs_save_) {}
+
+Chunk& Chunk::operator=(const Chunk& other)
+{
+	if (this != &other)
+		*this = Chunk(other);
+	return *this;
+}
 
 Chunk::ChunkData& Chunk::modifyData()
 {
 	changed_ = true;
-	return data_;
+	needs_save_ = true;
+	solids_.reset();
+	return const_cast<ChunkData&>(data());
 }
 
 const Chunk::ChunkData& Chunk::data() const
 {
-	return data_;
+	if (!data_)
+	{
+		data_ = std::make_unique<ChunkData>();
+		compact_.expand(data_->data());
+		compact_ = PalettedBlocks();
+	}
+	return *data_;
+}
+
+block_id_t Chunk::block_id(CoordElem x, CoordElem y, CoordElem z) const
+{
+	const size_t i = convert_index(x, y, z);
+	return data_ ? (*data_)[i].block_id() : compact_.get(i);
+}
+
+void Chunk::set_block_id(CoordElem x, CoordElem y, CoordElem z,
+		block_id_t id)
+{
+	const size_t i = convert_index(x, y, z);
+	if (data_)
+		(*data_)[i].set_block_id(id);
+	else
+		compact_.set(i, id);
+	changed_ = true;
+	needs_save_ = true;
+	solids_.reset();
+}
+
+ChunkLight& Chunk::reset_light()
+{
+	light_ = std::make_unique<ChunkLight>(block_count);
+	return *light_;
+}
+
+Chunk::ChunkData Chunk::expanded() const
+{
+	if (data_)
+		return *data_;
+	ChunkData blocks;
+	compact_.expand(blocks.data());
+	return blocks;
+}
+
+void Chunk::compact() const
+{
+	if (!data_)
+		return;
+	compact_ = PalettedBlocks(data_->data(), block_count);
+	data_.reset();
+}
+
+size_t Chunk::storage_bytes() const
+{
+	return data_ ? sizeof(ChunkData) : compact_.bytes();
+}
+
+bool Chunk::empty() const
+{
+	if (!data_)
+		return compact_.uniform() && compact_.get(0) == 0;
+	return std::all_of(data_->begin(), data_->end(),
+			[](const Block &b) { return b.block_id() == 0; });
+}
+
+void ChunkColumn::set_section(int s, std::shared_ptr<Chunk> chunk)
+{
+	if (chunk && chunk->empty())
+		chunk = nullptr;
+	sections_[s] = std::move(chunk);
+}
+
+block_id_t ChunkColumn::block_id(CoordElem x, CoordElem y, int z) const
+{
+	const auto &section = sections_[z / Chunk::chunk_height];
+	return section ? section->block_id(x, y, z % Chunk::chunk_height) : 0;
+}
+
+size_t ChunkColumn::allocated_sections() const
+{
+	return std::count_if(sections_.begin(), sections_.end(),
+			[](const std::shared_ptr<Chunk> &s) { return s != nullptr; });
+}
+
+size_t ChunkColumn::storage_bytes() const
+{
+	size_t bytes = 0;
+	for (const auto &s : sections_)
+		if (s)
+			bytes += s->storage_bytes();
+	return bytes;
+}
+
+namespace
+{
+
+// splitmix64 finalizer: spreads neighbouring coordinates over the table.
+inline std::uint64_t hash_key(std::uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ull;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebull;
+	key ^= key >> 31;
+	return key;
+}
+
+constexpr size_t initial_capacity = 64;
+
+}
+
+ChunkMap::ChunkMap() :
+		slots_(initial_capacity, Slot
+		{ 0, nullptr }), owners_(initial_capacity), mask_(initial_capacity - 1)
+{
+}
+
+size_t ChunkMap::slot_of(std::uint64_t key) const
+{
+	size_t i = hash_key(key) & mask_;
+	while (slots_[i].chunk && slots_[i].key != key)
+		i = (i + 1) & mask_;
+	return i;
+}
+
+Chunk* ChunkMap::find(const ChunkCoord &c) const
+{
+	return slots_[slot_of(pack_chunk_coord(c))].chunk;
+}
+
+const std::shared_ptr<Chunk>* ChunkMap::find_shared(const ChunkCoord &c) const
+{
+	const size_t i = slot_of(pack_chunk_coord(c));
+	return slots_[i].chunk ? &owners_[i] : nullptr;
+}
+
+void ChunkMap::insert_or_assign(const ChunkCoord &c,
+		std::shared_ptr<Chunk> chunk)
+{
+	if (!chunk)
+	{
+		erase(c);
+		return;
+	}
+
+	// keep the load factor at or below 3/4
+	if ((size_ + 1) * 4 > slots_.size() * 3)
+		rehash(slots_.size() * 2);
+
+	const auto key = pack_chunk_coord(c);
+	const size_t i = slot_of(key);
+	if (!slots_[i].chunk)
+		size_++;
+	slots_[i] =
+	{ key, chunk.get() };
+	owners_[i] = std::move(chunk);
+}
+
+bool ChunkMap::erase(const ChunkCoord &c)
+{
+	size_t i = slot_of(pack_chunk_coord(c));
+	if (!slots_[i].chunk)
+		return false;
+
+	// backward-shift deletion: pull later entries of the probe run into
+	// the hole so that no tombstones are needed.
+	size_t j = i;
+	for (;;)
+	{
+		j = (j + 1) & mask_;
+		if (!slots_[j].chunk)
+			break;
+		const size_t home = hash_key(slots_[j].key) & mask_;
+		// move j into i unless its home lies cyclically in (i, j]
+		const bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+		if (stays)
+			continue;
+		slots_[i] = slots_[j];
+		owners_[i] = std::move(owners_[j]);
+		i = j;
+	}
+	slots_[i] =
+	{ 0, nullptr };
+	owners_[i].reset();
+	size_--;
+	return true;
+}
+
+void ChunkMap::reserve(size_t count)
+{
+	size_t capacity = slots_.size();
+	while (count * 4 > capacity * 3)
+		capacity *= 2;
+	if (capacity != slots_.size())
+		rehash(capacity);
+}
+
+void ChunkMap::rehash(size_t capacity)
+{
+	std::vector<Slot> old_slots(capacity, Slot
+	{ 0, nullptr });
+	std::vector<std::shared_ptr<Chunk>> old_owners(capacity);
+	old_slots.swap(slots_);
+	old_owners.swap(owners_);
+	mask_ = capacity - 1;
+
+	for (size_t i = 0; i < old_slots.size(); i++)
+	{
+		if (!old_slots[i].chunk)
+			continue;
+		const size_t j = slot_of(old_slots[i].key);
+		slots_[j] = old_slots[i];
+		owners_[j] = std::move(old_owners[i]);
+	}
+}
+
+void World::set_column(CoordElem x, CoordElem y, const ChunkColumn &column)
+{
+	for (int s = 0; s < ChunkColumn::sections; s++)
+		set_chunk(ChunkCoord(x, y, s), column.section(s));
+}
+
+ChunkColumn World::column(CoordElem x, CoordElem y) const
+{
+	ChunkColumn column;
+	for (int s = 0; s < ChunkColumn::sections; s++)
+	{
+		const auto p = chunks_.find_shared(ChunkCoord(x, y, s));
+		if (p)
+			column.set_section(s, *p);
+	}
+	return column;
+}
+
+block_id_t World::block_id(std::int64_t x, std::int64_t y,
+		std::int64_t z) const
+{
+	CoordElem local[3];
+	const Chunk *chunk = find_chunk(block_chunk(x, y, z, local));
+	if (!chunk)
+		return 0;
+	return chunk->block_id(local[0], local[1], local[2]);
 }
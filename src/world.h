@@ -2,16 +2,21 @@
 
 #include <vector>
 #include "block.h"
+#include "chunk_storage.h"
 #include <map>
 #include <memory>
 #include <array>
 #include <optional>
+#include <cstdint>
+#include <utility>
+
 
 namespace mycraft
 {
 
 class World;
 class Chunk;
+class ChunkColumn;
 
 using CoordElem = int32_t;
 
@@ -116,6 +121,72 @@ struct Coord3DSort
 
 using ChunkCoord = Coord3D<CoordElem>;
 
+// Packs a chunk coordinate into 64 bits: 24 bits each for x and y,
+// 16 bits for z (two's complement, so negative coordinates work).
+inline std::uint64_t pack_chunk_coord(const ChunkCoord &c)
+{
+	return ((std::uint64_t) (c.x() & 0xffffff) << 40)
+			| ((std::uint64_t) (c.y() & 0xffffff) << 16)
+			| (std::uint64_t) (c.z() & 0xffff);
+}
+
+inline ChunkCoord unpack_chunk_coord(std::uint64_t key)
+{
+	// shift the fields to the top and back to sign-extend them
+	return ChunkCoord((CoordElem) ((std::int64_t) key >> 40),
+			(CoordElem) ((std::int64_t) (key << 24) >> 40),
+			(CoordElem) ((std::int64_t) (key << 48) >> 48));
+}
+
+// Open-addressing (linear probing) hash map from chunk coordinates to
+// chunks. Keys and raw pointers sit in one flat array so lookups touch a
+// single cache line in the common case; owning pointers are kept in a
+// parallel array that lookups never read.
+class ChunkMap
+{
+public:
+	ChunkMap();
+
+	// non-owning lookup; nullptr if absent.
+	Chunk* find(const ChunkCoord &c) const;
+	const std::shared_ptr<Chunk>* find_shared(const ChunkCoord &c) const;
+
+	// A null chunk erases the entry.
+	void insert_or_assign(const ChunkCoord &c, std::shared_ptr<Chunk> chunk);
+	bool erase(const ChunkCoord &c);
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	void reserve(size_t count);
+
+	// f(const ChunkCoord&, const std::shared_ptr<Chunk>&) for every entry.
+	template<typename F>
+	void for_each(F &&f) const
+	{
+		for (size_t i = 0; i < slots_.size(); i++)
+			if (slots_[i].chunk)
+				f(unpack_chunk_coord(slots_[i].key), owners_[i]);
+	}
+
+private:
+	struct Slot
+	{
+		std::uint64_t key;
+		Chunk *chunk; // nullptr marks an empty slot
+	};
+
+	std::vector<Slot> slots_;
+	std::vector<std::shared_ptr<Chunk>> owners_;
+	size_t size_ = 0;
+	size_t mask_;
+
+	size_t slot_of(std::uint64_t key) const;
+	void rehash(size_t capacity);
+};
+
 class World
 {
 public:
@@ -124,9 +195,16 @@ public:
 	std::optional<std::shared_ptr<Chunk>>
 	chunk(const ChunkCoord &c) const
 	{
-		const auto it = chunks_.find(c);
-		if (it == chunks_.end()) return {};
-		else return std::optional<std::shared_ptr<Chunk>>(it->second);
+		const auto p = chunks_.find_shared(c);
+		if (!p) return {};
+		else return std::optional<std::shared_ptr<Chunk>>(*p);
+	}
+
+	// Non-owning lookup for hot loops: no reference count traffic.
+	// The pointer stays valid until the chunk is replaced or freed.
+	Chunk* find_chunk(const ChunkCoord &c) const
+	{
+		return chunks_.find(c);
 	}
 
 	void set_chunk(const ChunkCoord &c, std::shared_ptr<Chunk> chunk)
@@ -139,10 +217,33 @@ public:
 		chunks_.erase(c);
 	}
 
+	size_t chunk_count() const
+	{
+		return chunks_.size();
+	}
+
+	// f(const ChunkCoord&, const std::shared_ptr<Chunk>&) for every chunk.
+	template<typename F>
+	void for_each_chunk(F &&f) const
+	{
+		chunks_.for_each(std::forward<F>(f));
+	}
+
+	// Stores the allocated sections of column as chunks (x, y, 0 ..
+	// ChunkColumn::sections - 1); the chunks of its empty sections are
+	// freed instead.
+	void set_column(CoordElem x, CoordElem y, const ChunkColumn &column);
+	ChunkColumn column(CoordElem x, CoordElem y) const;
+
+	// The block at world block position (x, y, z); air where no chunk
+	// is stored.
+	block_id_t block_id(std::int64_t x, std::int64_t y, std::int64_t z) const;
+
 private:
-	std::map<ChunkCoord, std::shared_ptr<Chunk>, Coord3DSort> chunks_;
+	ChunkMap chunks_;
 };
 
+
 class Chunk
 {
 public:
@@ -153,14 +254,60 @@ public:
 
 	using ChunkData = std::array<Block, chunk_length*chunk_length*chunk_height>;
 
+	constexpr static size_t block_count = chunk_length*chunk_length*chunk_height;
+
+	// A chunk is either expanded (a flat ChunkData) or compact (see
+	// PalettedBlocks). New chunks are all air and compact.
 	Chunk();
+	// compact, every block fill
+	explicit Chunk(block_id_t fill);
 	Chunk(const ChunkData& data);
-
+	// compact, holding blocks
+	explicit Chunk(PalettedBlocks blocks);
+	Chunk(const Chunk& other);
+	Chunk(Chunk&& other) noexcept = default;
+	Chunk& operator=(const Chunk& other);
+	Chunk& operator=(Chunk&& other) noexcept = default;
+
+	// Expand a compact chunk first. The reference is valid until the
+	// next compact(). Not thread-safe on a shared compact chunk.
 	const ChunkData& data() const;
 	ChunkData& modifyData();
 
+	// Random access in either form, without expanding.
+	block_id_t block_id(CoordElem x, CoordElem y, CoordElem z) const;
+	void set_block_id(CoordElem x, CoordElem y, CoordElem z, block_id_t id);
+
+	// A copy of the blocks that leaves the chunk in its current form.
+	ChunkData expanded() const;
+
+	// Recompresses an expanded chunk; call once it is idle.
+	void compact() const;
+	bool compacted() const { return !data_; }
+
+	// bytes used by the blocks in the current form.
+	size_t storage_bytes() const;
+
+	// true if every block is air.
+	bool empty() const;
+
+	// Light of the blocks; null until a LightEngine lit the chunk.
+	const ChunkLight* light() const { return light_.get(); }
+	ChunkLight* light() { return light_.get(); }
+	// replaces the light with all dark
+	ChunkLight& reset_light();
+
+	// Which blocks are solid, as built by a CollisionWorld; null until
+	// one needs it and again after any change of the blocks.
+	const ChunkMask* solids() const { return solids_.get(); }
+	void set_solids(std::unique_ptr<ChunkMask> solids) const { solids_ = std::move(solids); }
+
+	// set by modifyData(). changed() is consumed by meshing,
+	// needs_save() by RegionStore.
 	bool changed() const { return changed_; }
 	void set_changed(bool changed) const { changed_ = changed; }
+	bool needs_save() const { return needs_save_; }
+	void set_needs_save(bool needs_save) const { needs_save_ = needs_save; }
 
 	inline static constexpr size_t convert_index(CoordElem x, CoordElem y, CoordElem z)
 	{
@@ -170,9 +317,65 @@ public:
 	}
 
 private:
-	ChunkData data_;
+	// expanded blocks, or null while compact_ holds them
+	mutable std::unique_ptr<ChunkData> data_;
+	mutable PalettedBlocks compact_;
+	std::unique_ptr<ChunkLight> light_;
+	mutable std::unique_ptr<ChunkMask> solids_;
 
 	mutable bool changed_ = false;
+	mutable bool needs_save_ = false;
+};
+
+// A vertical stack of sections (chunks) z = 0 .. sections - 1 at one
+// chunk column (x, y), height blocks tall. Sections that are all air are
+// not allocated; lookups read them as air.
+class ChunkColumn
+{
+public:
+	constexpr static int sections = 16;
+	constexpr static int height = sections * Chunk::chunk_height;
+
+	// nullptr for an empty section.
+	const std::shared_ptr<Chunk>& section(int s) const
+	{
+		return sections_[s];
+	}
+
+	// An empty chunk is dropped rather than stored.
+	void set_section(int s, std::shared_ptr<Chunk> chunk);
+
+	// x, y in the column, z in [0, height).
+	block_id_t block_id(CoordElem x, CoordElem y, int z) const;
+
+	size_t allocated_sections() const;
+
+	// bytes used by the blocks of the allocated sections.
+	size_t storage_bytes() const;
+
+private:
+	std::array<std::shared_ptr<Chunk>, sections> sections_;
 };
 
+// floor(a / b) for b > 0
+inline std::int64_t floor_div(std::int64_t a, std::int64_t b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// The chunk holding world block position (x, y, z); local receives the
+// block's position within it.
+inline ChunkCoord block_chunk(std::int64_t x, std::int64_t y, std::int64_t z,
+		CoordElem local[3])
+{
+	constexpr auto cs = Chunk::chunk_length;
+	constexpr auto mz = Chunk::chunk_height;
+	const auto cx = floor_div(x, cs), cy = floor_div(y, cs), cz = floor_div(z,
+			mz);
+	local[0] = (CoordElem) (x - cx * cs);
+	local[1] = (CoordElem) (y - cy * cs);
+	local[2] = (CoordElem) (z - cz * mz);
+	return ChunkCoord((CoordElem) cx, (CoordElem) cy, (CoordElem) cz);
+}
+
 }
@@ -0,0 +1,232 @@
+#include "world_edit.h"
+#include "light.h"
+
+#include <cmath>
+#include <unordered_set>
+
+using namespace mycraft;
+
+namespace
+{
+
+constexpr CoordElem chunk_dims[3] =
+{ Chunk::chunk_length, Chunk::chunk_length, Chunk::chunk_height };
+
+// edits to one compact chunk above which it is expanded for the batch
+// and compacted again, instead of repacking the palette in place
+constexpr size_t expand_threshold = 256;
+
+}
+
+std::vector<WorldEdit::LocalEdit>& WorldEdit::edits_of(const ChunkCoord &c)
+{
+	const auto key = pack_chunk_coord(c);
+	if (!last_ || key != last_key_)
+	{
+		last_key_ = key;
+		last_ = &chunks_[key];
+	}
+	return *last_;
+}
+
+void WorldEdit::set_block(std::int64_t x, std::int64_t y, std::int64_t z,
+		block_id_t id)
+{
+	CoordElem local[3];
+	const auto c = block_chunk(x, y, z, local);
+	edits_of(c).push_back(
+			{ (std::uint16_t) Chunk::convert_index(local[0], local[1], local[2]),
+					id });
+	size_++;
+}
+
+void WorldEdit::apply(const BlockEdit *edits, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		set_block(edits[i].x, edits[i].y, edits[i].z, edits[i].id);
+}
+
+template<typename Inside>
+void WorldEdit::fill(const std::int64_t lo[3], const std::int64_t hi[3],
+		block_id_t id, Inside inside)
+{
+	// chunk by chunk, so that each chunk's list is looked up once
+	std::int64_t clo[3], chi[3];
+	for (int a = 0; a < 3; a++)
+	{
+		if (hi[a] < lo[a])
+			return;
+		clo[a] = floor_div(lo[a], chunk_dims[a]);
+		chi[a] = floor_div(hi[a], chunk_dims[a]);
+	}
+
+	for (auto cx = clo[0]; cx <= chi[0]; cx++)
+		for (auto cy = clo[1]; cy <= chi[1]; cy++)
+			for (auto cz = clo[2]; cz <= chi[2]; cz++)
+			{
+				const std::int64_t base[3] =
+				{ cx * chunk_dims[0], cy * chunk_dims[1], cz * chunk_dims[2] };
+				CoordElem from[3], to[3];
+				for (int a = 0; a < 3; a++)
+				{
+					from[a] = (CoordElem) (std::max(lo[a], base[a]) - base[a]);
+					to[a] = (CoordElem) (std::min(hi[a],
+							base[a] + chunk_dims[a] - 1) - base[a]);
+				}
+
+				auto &edits = edits_of(
+						ChunkCoord((CoordElem) cx, (CoordElem) cy,
+								(CoordElem) cz));
+				for (auto i = from[0]; i <= to[0]; i++)
+					for (auto j = from[1]; j <= to[1]; j++)
+						for (auto k = from[2]; k <= to[2]; k++)
+						{
+							if (!inside(base[0] + i, base[1] + j, base[2] + k))
+								continue;
+							edits.push_back(
+									{ (std::uint16_t) Chunk::convert_index(i, j, k),
+											id });
+							size_++;
+						}
+			}
+}
+
+void WorldEdit::fill_box(std::int64_t x0, std::int64_t y0, std::int64_t z0,
+		std::int64_t x1, std::int64_t y1, std::int64_t z1, block_id_t id)
+{
+	const std::int64_t lo[3] =
+	{ x0, y0, z0 };
+	const std::int64_t hi[3] =
+	{ x1, y1, z1 };
+	fill(lo, hi, id, [](std::int64_t, std::int64_t, std::int64_t)
+	{	return true;});
+}
+
+void WorldEdit::fill_sphere(double cx, double cy, double cz, double radius,
+		block_id_t id)
+{
+	// block (x, y, z) spans [x, x + 1); its centre is at x + 0.5
+	const double c[3] =
+	{ cx - 0.5, cy - 0.5, cz - 0.5 };
+	std::int64_t lo[3], hi[3];
+	for (int a = 0; a < 3; a++)
+	{
+		lo[a] = (std::int64_t) std::ceil(c[a] - radius);
+		hi[a] = (std::int64_t) std::floor(c[a] + radius);
+	}
+	const double r2 = radius * radius;
+	fill(lo, hi, id, [&c, r2](std::int64_t x, std::int64_t y, std::int64_t z)
+	{
+		const double dx = x - c[0], dy = y - c[1], dz = z - c[2];
+		return dx * dx + dy * dy + dz * dz <= r2;
+	});
+}
+
+void WorldEdit::clear()
+{
+	chunks_.clear();
+	last_ = nullptr;
+	size_ = 0;
+}
+
+EditResult WorldEdit::commit(World &world, LightEngine *light)
+{
+	EditResult result;
+	for (auto &entry : chunks_)
+	{
+		const auto coord = unpack_chunk_coord(entry.first);
+		const auto &edits = entry.second;
+		if (edits.empty())
+			continue;
+
+		Chunk *chunk = world.find_chunk(coord);
+		if (!chunk)
+		{
+			// an empty section: stays unallocated unless something
+			// other than air goes in
+			const bool only_air = std::all_of(edits.begin(), edits.end(),
+					[](const LocalEdit &e) { return e.id == 0; });
+			if (only_air)
+				continue;
+			auto created = std::make_shared<Chunk>();
+			chunk = created.get();
+			world.set_chunk(coord, std::move(created));
+			result.created.push_back(coord);
+			if (light)
+				light->light_chunk(coord);
+		}
+
+		const bool expand = chunk->compacted()
+				&& edits.size() >= expand_threshold;
+		if (expand)
+			chunk->data();
+
+		DirtyRegion region;
+		for (const auto &e : edits)
+		{
+			const CoordElem x = e.index / (Chunk::chunk_length
+					* Chunk::chunk_height);
+			const CoordElem y = e.index / Chunk::chunk_height
+					% Chunk::chunk_length;
+			const CoordElem z = e.index % Chunk::chunk_height;
+			const auto old_id = chunk->block_id(x, y, z);
+			if (old_id == e.id)
+				continue;
+			chunk->set_block_id(x, y, z, e.id);
+			region.add(x, y, z);
+			result.blocks_changed++;
+			if (light)
+				light->block_changed(
+						(std::int64_t) coord.x() * Chunk::chunk_length + x,
+						(std::int64_t) coord.y() * Chunk::chunk_length + y,
+						(std::int64_t) coord.z() * Chunk::chunk_height + z,
+						old_id);
+		}
+
+		if (expand)
+			chunk->compact();
+		if (!region.empty())
+			result.edited.emplace_back(coord, region);
+	}
+	clear();
+	if (light)
+	{
+		light->propagate();
+		result.relit = light->take_relit();
+	}
+
+	// one re-mesh per chunk, including neighbours that see the change
+	// across their border
+	std::unordered_set<std::uint64_t> queued;
+	auto queue = [&](const ChunkCoord &c)
+	{
+		if (queued.insert(pack_chunk_coord(c)).second)
+			result.remesh.push_back(c);
+	};
+	for (const auto &edited : result.edited)
+		queue(edited.first);
+	for (const auto &relit : result.relit)
+		queue(relit.first);
+	auto queue_neighbours = [&](const std::pair<ChunkCoord, DirtyRegion> &edited)
+	{
+		const auto &region = edited.second;
+		for (int a = 0; a < 3; a++)
+			for (const int side : { -1, 1 })
+			{
+				if (side < 0 ? region.min[a] != 0 :
+						region.max[a] != chunk_dims[a] - 1)
+					continue;
+				CoordElem n[3] =
+				{ edited.first.x(), edited.first.y(), edited.first.z() };
+				n[a] += side;
+				const ChunkCoord neighbour(n[0], n[1], n[2]);
+				if (world.find_chunk(neighbour))
+					queue(neighbour);
+			}
+	};
+	for (const auto &edited : result.edited)
+		queue_neighbours(edited);
+	for (const auto &relit : result.relit)
+		queue_neighbours(relit);
+	return result;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "block.h"
+#include "world.h"
+
+namespace mycraft
+{
+
+class LightEngine;
+
+// A change of the block at world block position (x, y, z).
+struct BlockEdit
+{
+	std::int64_t x, y, z;
+	block_id_t id;
+};
+
+// Bounding box of the blocks changed in one chunk, in chunk-local
+// coordinates (inclusive). Empty until the first add().
+struct DirtyRegion
+{
+	std::array<CoordElem, 3> min
+	{ Chunk::chunk_length, Chunk::chunk_length, Chunk::chunk_height };
+	std::array<CoordElem, 3> max
+	{ -1, -1, -1 };
+
+	bool empty() const
+	{
+		return max[0] < min[0];
+	}
+
+	void add(CoordElem x, CoordElem y, CoordElem z)
+	{
+		const CoordElem p[3] =
+		{ x, y, z };
+		for (int a = 0; a < 3; a++)
+		{
+			min[a] = std::min(min[a], p[a]);
+			max[a] = std::max(max[a], p[a]);
+		}
+	}
+};
+
+// What WorldEdit::commit() did to the world.
+struct EditResult
+{
+	// chunks whose blocks changed, and where
+	std::vector<std::pair<ChunkCoord, DirtyRegion>> edited;
+	// chunks allocated for edits in empty sections (also in edited)
+	std::vector<ChunkCoord> created;
+	// chunks whose light changed, and where (with a LightEngine)
+	std::vector<std::pair<ChunkCoord, DirtyRegion>> relit;
+	// each chunk whose mesh is out of date, once: the edited chunks and
+	// the loaded neighbours whose border layer a dirty or relit region
+	// touches
+	std::vector<ChunkCoord> remesh;
+	size_t blocks_changed = 0;
+};
+
+// A batch of block edits by world position. Edits are grouped per chunk
+// as they are queued and written to the world by commit(), which only
+// touches chunks (and marks them changed) where a block really changes.
+// Later edits of the same block win.
+class WorldEdit
+{
+public:
+	void set_block(std::int64_t x, std::int64_t y, std::int64_t z,
+			block_id_t id);
+	void apply(const BlockEdit *edits, size_t count);
+	void apply(const std::vector<BlockEdit> &edits)
+	{
+		apply(edits.data(), edits.size());
+	}
+
+	// every block in the box [min, max] (inclusive).
+	void fill_box(std::int64_t x0, std::int64_t y0, std::int64_t z0,
+			std::int64_t x1, std::int64_t y1, std::int64_t z1, block_id_t id);
+
+	// every block whose centre is within radius of (cx, cy, cz).
+	void fill_sphere(double cx, double cy, double cz, double radius,
+			block_id_t id);
+
+	// queued edits
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	void clear();
+
+	// Applies the queued edits to world chunk by chunk and clears the
+	// batch. Chunks are created for non-air edits where none is stored;
+	// compact chunks are left compact. With light, the light around the
+	// changed blocks is updated as well (created chunks are lit first).
+	EditResult commit(World &world, LightEngine *light = nullptr);
+
+private:
+	struct LocalEdit
+	{
+		std::uint16_t index; // Chunk::convert_index
+		block_id_t id;
+	};
+
+	std::vector<LocalEdit>& edits_of(const ChunkCoord &c);
+	template<typename Inside>
+	void fill(const std::int64_t lo[3], const std::int64_t hi[3],
+			block_id_t id, Inside inside);
+
+	// keyed by pack_chunk_coord
+	std::unordered_map<std::uint64_t, std::vector<LocalEdit>> chunks_;
+	// the chunk of the previous edit: runs of edits mostly hit one chunk
+	std::uint64_t last_key_ = 0;
+	std::vector<LocalEdit> *last_ = nullptr;
+	size_t size_ = 0;
+};
+
+}
@@ -1,13 +1,40 @@
 #include "worldgen.h"
 #include "perlin.h"
+#include <algorithm>
 #include <cmath>
 #include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "block.h"
 
 using namespace mycraft;
 
-WorldGenerator::WorldGenerator(std::uint32_t seed)
+namespace
 {
+constexpr auto noise_cell_size = Chunk::chunk_length / 2;
+constexpr auto noise_layers = 4;
+// the [0, 1] noise becomes a displacement of [-bias, 1 - bias] * chunk_height
+constexpr auto noise_bias = 0.3;
+}
+
+WorldGenerator::WorldGenerator(std::uint32_t seed, TerrainMode mode,
+		int ground_level) :
+		seed_(seed), mode_(mode), ground_level_(ground_level)
+{
+	constexpr auto mz = Chunk::chunk_height;
+	lowest_ground_ = (std::int64_t) std::ceil(
+			ground_level - noise_bias * mz);
+	highest_ground_ = (std::int64_t) std::ceil(
+			ground_level + (1 - noise_bias) * mz);
+
+	// the noise repeats every 256 cells, so any offset in [0, 256) cells
+	// gives a different world
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> offset(0, 256.0 * noise_cell_size);
+	offset_x_ = offset(rng);
+	offset_y_ = offset(rng);
+	offset_z_ = offset(rng);
 }
 
 template<typename Array, typename T>
@@ -35,56 +62,196 @@ Target step(const Src &x, const Src &threashold, const Target &t,
 	return x >= threashold ? t : f;
 }
 
-template<typename T>
-int step(const T &x)
+Chunk WorldGenerator::generate_chunk(CoordElem base_x,
+		CoordElem base_y, CoordElem base_z) const
 {
-	return step(x, 0.5, 1, 0);
+	if (mode_ == TerrainMode::HEIGHTMAP)
+		return generate_chunk(generate_heightmap(base_x, base_y), base_z);
+	return generate_density_chunk(base_x, base_y, base_z);
 }
 
-Chunk WorldGenerator::generate_chunk(CoordElem base_x,
-		CoordElem base_y, CoordElem base_z)
+bool WorldGenerator::above_surface(CoordElem base_z) const
+{
+	return (std::int64_t) base_z * Chunk::chunk_height >= highest_ground_;
+}
+
+bool WorldGenerator::below_surface(CoordElem base_z) const
+{
+	return ((std::int64_t) base_z + 1) * Chunk::chunk_height
+			<= lowest_ground_;
+}
+
+ChunkColumn WorldGenerator::generate_column(CoordElem x, CoordElem y) const
+{
+	constexpr auto mz = Chunk::chunk_height;
+	ChunkColumn column;
+	if (mode_ != TerrainMode::HEIGHTMAP)
+	{
+		for (int s = 0; s < ChunkColumn::sections && !above_surface(s); s++)
+			column.set_section(s,
+					std::make_shared<Chunk>(generate_density_chunk(x, y, s)));
+		return column;
+	}
+
+	const auto heightmap = generate_heightmap(x, y);
+	const auto top = *std::max_element(heightmap.surface.begin(),
+			heightmap.surface.end());
+	for (int s = 0; s < ChunkColumn::sections && s * mz < top; s++)
+		column.set_section(s,
+				std::make_shared<Chunk>(generate_chunk(heightmap, s)));
+	return column;
+}
+
+Heightmap WorldGenerator::generate_heightmap(CoordElem base_x,
+		CoordElem base_y) const
 {
 	constexpr auto cs = Chunk::chunk_length;
 	constexpr auto mz = Chunk::chunk_height;
-	constexpr auto csmz = cs * mz;
 
-	std::unique_ptr<std::array<double, cs*cs*mz>> pb(new std::array<double, cs*cs*mz>);
+	// a z = 0 slice of the same noise field as the 3D path, scaled the
+	// same way: ground at ground_level_, displaced by [-0.3, 0.7] * mz
+	std::array<double, cs * cs> noise;
+	perlin::perlin3d_fractal(noise.data(), cs, cs, 1, noise_cell_size,
+			noise_layers, offset_x_ + (double) base_x * cs,
+			offset_y_ + (double) base_y * cs, offset_z_);
 
+	Heightmap heightmap;
+	for (int i = 0; i < cs; i++)
+		for (int j = 0; j < cs; j++)
+		{
+			// solid where z < ground, i.e. up to ceil(ground) - 1
+			const double ground = ground_level_
+					+ (noise[i * cs + j] - noise_bias) * mz;
+			heightmap(i, j) = (std::int32_t) std::ceil(ground);
+		}
+	return heightmap;
+}
 
-	for (int z = 0; z < mz; z++)
-	{
-		for (int i = 0; i < cs; i++)
+Chunk WorldGenerator::generate_chunk(const Heightmap &heightmap,
+		CoordElem base_z) const
+{
+	constexpr auto cs = Chunk::chunk_length;
+	constexpr auto mz = Chunk::chunk_height;
+	const std::int64_t wz = (std::int64_t) base_z * mz;
+
+	const auto bounds = std::minmax_element(heightmap.surface.begin(),
+			heightmap.surface.end());
+	if (wz >= *bounds.second)
+		return Chunk();
+	if (wz + mz <= *bounds.first)
+		return Chunk(1);
+
+	// a column is contiguous in ChunkData: fill it as ground + air runs
+	Chunk::ChunkData blocks;
+	for (int i = 0; i < cs; i++)
+		for (int j = 0; j < cs; j++)
 		{
-			for (int j = 0; j < cs; j++)
-			{
-				(*pb)[i * csmz + j * mz + z] = (double) z / mz;
-			}
+			const auto ground = std::clamp<std::int64_t>(heightmap(i, j) - wz, 0,
+					mz);
+			auto column = blocks.begin() + Chunk::convert_index(i, j, 0);
+			std::fill(column, column + ground, Block(1));
+			std::fill(column + ground, column + mz, Block(0));
 		}
-	}
 
-	// TODO: use base_[xyz] to generate different chunks
-	auto noise = perlin::perlin3d_image(cs, cs, mz, cs / 2, 4);
+	return Chunk(std::move(blocks));
+}
+
+Chunk WorldGenerator::generate_density_chunk(CoordElem base_x,
+		CoordElem base_y, CoordElem base_z) const
+{
+	constexpr auto cs = Chunk::chunk_length;
+	constexpr auto mz = Chunk::chunk_height;
+	constexpr auto csmz = cs * mz;
+
+	if (above_surface(base_z))
+		return Chunk();
+	if (below_surface(base_z))
+		return Chunk(1);
+
+	// world position of the chunk's first block
+	const double wx = (double) base_x * cs;
+	const double wy = (double) base_y * cs;
+	const double wz = (double) base_z * mz;
+
+	std::array<double, cs * cs * mz> noise;
+	perlin::perlin3d_fractal(noise.data(), cs, cs, mz, noise_cell_size,
+			noise_layers, offset_x_ + wx, offset_y_ + wy, offset_z_ + wz);
 	// noise is [0, 1]
-	array_add(noise, cs * cs * mz, -0.3); // [-0.5, 0.5] (with bias)
+	array_add(noise, cs * cs * mz, -noise_bias); // [-0.5, 0.5] (with bias)
 	array_mul(noise, cs * cs * mz, mz);
 	// noise is now [-mz/2, mz/2]
 
-	std::array<Block, cs*cs*mz> blocks;
+	// Solid below ground_level_ (world z), displaced by the noise.
+	Chunk::ChunkData blocks;
 	for (int j = 0; j < cs; j++)
 	{
 		for (int i = 0; i < cs; i++)
 		{
 			for (int k = 0; k < mz; k++)
 			{
-				auto kk = (int) std::round(k + noise[i * csmz + j * mz + k]);
-				if (kk >= mz)
-					kk = mz - 1;
-				else if (kk < 0)
-					kk = 0;
-				blocks[Chunk::convert_index(i, j, k)] = Block(step((*pb)[i * csmz + j * mz + kk])); // Block id 0 or 1
+				const double h = wz + k - noise[i * csmz + j * mz + k];
+				blocks[Chunk::convert_index(i, j, k)] = Block(
+						step(h, (double) ground_level_, 0, 1)); // Block id 0 or 1
 			}
 		}
 	}
 
 	return Chunk(std::move(blocks));
 }
+
+void WorldGenerator::generate_region(World &world, const ChunkCoord &min,
+		const ChunkCoord &max, unsigned threads) const
+{
+	// z innermost, so that a column's chunks are adjacent
+	std::vector<ChunkCoord> coords;
+	for (auto x = min.x(); x <= max.x(); x++)
+		for (auto y = min.y(); y <= max.y(); y++)
+			for (auto z = min.z(); z <= max.z(); z++)
+				coords.emplace_back(x, y, z);
+	if (coords.empty())
+		return;
+
+	// work items: whole columns in HEIGHTMAP mode (one heightmap shared
+	// by the stack), single chunks otherwise
+	const size_t stack =
+			mode_ == TerrainMode::HEIGHTMAP ? max.z() - min.z() + 1 : 1;
+	const size_t items = coords.size() / stack;
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min<size_t>(threads, items);
+
+	// workers only write their own slots; World is filled afterwards
+	// on this thread because it is not thread-safe.
+	std::vector<std::shared_ptr<Chunk>> chunks(coords.size());
+	std::atomic<size_t> next(0);
+	auto work = [&]
+	{
+		for (size_t item; (item = next.fetch_add(1)) < items;)
+		{
+			const size_t first = item * stack;
+			const auto &c = coords[first];
+			if (mode_ != TerrainMode::HEIGHTMAP)
+			{
+				chunks[first] = std::make_shared<Chunk>(
+						generate_chunk(c.x(), c.y(), c.z()));
+				continue;
+			}
+			const auto heightmap = generate_heightmap(c.x(), c.y());
+			for (size_t i = first; i < first + stack; i++)
+				chunks[i] = std::make_shared<Chunk>(
+						generate_chunk(heightmap, coords[i].z()));
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threads; t++)
+		workers.emplace_back(work);
+	work();
+	for (auto &worker : workers)
+		worker.join();
+
+	for (size_t i = 0; i < coords.size(); i++)
+		if (!chunks[i]->empty())
+			world.set_chunk(coords[i], std::move(chunks[i]));
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <random>
 #include <cstdint>
 #include <memory>
@@ -8,44 +9,98 @@
 
 namespace mycraft
 {
-//class ChunkData
-//{
-//public:
-//	constexpr static int chunk_size = 16;
-//	constexpr static int max_z = 256;
-//
-//	ChunkData();
-//
-//	Block& query_block(int rx, int ry, int rz)
-//	{
-//		return _blocks[rx * chunk_size * max_z + ry * max_z + rz];
-//	}
-//
-//	const Block& query_block(int rx, int ry, int rz) const
-//	{
-//		return _blocks[rx * chunk_size * max_z + ry * max_z + rz];
-//	}
-//
-//	Block& operator()(int rx, int ry, int rz)
-//	{
-//		return query_block(rx, ry, rz);
-//	}
-//
-//	const Block& operator()(int rx, int ry, int rz) const
-//	{
-//		return query_block(rx, ry, rz);
-//	}
-//
-//private:
-//	std::unique_ptr<Block[]> _blocks;
-//};
+enum class TerrainMode
+{
+	// 3D noise thresholded per block (overhangs possible)
+	DENSITY_3D,
+	// one 2D noise sample per column, filled as runs of blocks
+	HEIGHTMAP
+};
+
+// Surface of one column of chunks: for each (i, j) in the chunk, the
+// world z of the lowest air block above the ground.
+struct Heightmap
+{
+	std::array<std::int32_t, Chunk::chunk_length * Chunk::chunk_length> surface;
+
+	std::int32_t& operator()(int i, int j)
+	{
+		return surface[i * Chunk::chunk_length + j];
+	}
+
+	std::int32_t operator()(int i, int j) const
+	{
+		return surface[i * Chunk::chunk_length + j];
+	}
+};
 
 class WorldGenerator
 {
 public:
-	WorldGenerator(std::uint32_t seed = 1);
+	// The terrain surface lies within [-0.3, 0.7] * Chunk::chunk_height
+	// of ground_level (world z, in blocks).
+	WorldGenerator(std::uint32_t seed = 1, TerrainMode mode =
+			TerrainMode::DENSITY_3D, int ground_level = Chunk::chunk_height / 2);
 
+	// base_[xyz] are chunk coordinates. The result only depends on the
+	// seed and the coordinates, so neighbouring chunks line up. Chunks
+	// wholly above or below the surface come back compact without
+	// sampling any noise.
+	// Safe to call from several threads at once.
 	[[nodiscard]] Chunk generate_chunk(CoordElem base_x,
-			CoordElem base_y, CoordElem base_z);
+			CoordElem base_y, CoordElem base_z) const;
+
+	// The heightmap of chunk column (base_x, base_y), shared by every
+	// chunk stacked in it (HEIGHTMAP mode).
+	[[nodiscard]] Heightmap generate_heightmap(CoordElem base_x,
+			CoordElem base_y) const;
+
+	// HEIGHTMAP-mode chunk at height base_z of the column whose
+	// heightmap is given.
+	[[nodiscard]] Chunk generate_chunk(const Heightmap &heightmap,
+			CoordElem base_z) const;
+
+	// The sections of chunk column (x, y). Sections above the surface
+	// are left unallocated and not generated at all.
+	[[nodiscard]] ChunkColumn generate_column(CoordElem x, CoordElem y) const;
+
+	// Generates every chunk in the box [min, max] (inclusive) on
+	// threads threads (0: all hardware threads) and stores the non-empty
+	// ones in world.
+	void generate_region(World &world, const ChunkCoord &min,
+			const ChunkCoord &max, unsigned threads = 0) const;
+
+	std::uint32_t seed() const
+	{
+		return seed_;
+	}
+
+	TerrainMode mode() const
+	{
+		return mode_;
+	}
+
+	int ground_level() const
+	{
+		return ground_level_;
+	}
+
+private:
+	[[nodiscard]] Chunk generate_density_chunk(CoordElem base_x,
+			CoordElem base_y, CoordElem base_z) const;
+
+	// world z bounds of the surface in DENSITY_3D mode: every block
+	// below lowest_ground_ is solid, every block from highest_ground_
+	// up is air.
+	bool above_surface(CoordElem base_z) const;
+	bool below_surface(CoordElem base_z) const;
+
+	std::uint32_t seed_;
+	TerrainMode mode_;
+	int ground_level_;
+	std::int64_t lowest_ground_, highest_ground_;
+	// seed-dependent origin of the noise field, in blocks
+	double offset_x_, offset_y_, offset_z_;
 };
+
 }